@@ -7,6 +7,9 @@
 #include <random>
 #include <algorithm>
 #include <sstream>
+#include <thread>
+#include <filesystem>
+#include <fstream>
 
 class benchmark_timer {
 private:
@@ -19,9 +22,9 @@ public:
     
     double stop() {
         auto end_time = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
             end_time - start_time);
-        return duration.count() / 1000.0; // Convert to milliseconds
+        return duration.count() / 1000000.0; // Convert to milliseconds
     }
 };
 
@@ -314,6 +317,45 @@ public:
                       << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time
                       << std::setw(20) << std::fixed << std::setprecision(0) << ops_per_sec << std::endl;
         }
+        
+        // Test cut/paste between buffers: selection copy vs. splice
+        {
+            const size_t block = 4096;
+            text_editor_buffer source = buffer;
+            text_editor_buffer target;
+            
+            benchmark_timer timer;
+            timer.start();
+            
+            for (size_t i = 0; i < operations && source.size() > block; ++i) {
+                size_t pos = (i * 131) % (source.size() - block);
+                std::string selection = source.get_selection(pos, pos + block);
+                source.delete_text(pos, block);
+                target.insert_text(target.size(), selection);
+                source.insert_text(pos, selection);  // Keep the source size steady
+            }
+            
+            double copy_time = timer.stop();
+            
+            timer.start();
+            
+            for (size_t i = 0; i < operations && source.size() > block; ++i) {
+                size_t pos = (i * 131) % (source.size() - block);
+                target.splice(target.size(), source, pos, block);
+                source.splice(pos, target, target.size() - block, block);
+            }
+            
+            double splice_time = timer.stop();
+            
+            std::cout << std::left << std::setw(30) << "cut_paste_copy"
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << copy_time
+                      << std::setw(20) << std::fixed << std::setprecision(0)
+                      << (operations * 1000.0) / copy_time << std::endl;
+            std::cout << std::left << std::setw(30) << "cut_paste_splice"
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << splice_time
+                      << std::setw(20) << std::fixed << std::setprecision(0)
+                      << (operations * 2 * 1000.0) / splice_time << std::endl;
+        }
     }
     
     // Memory usage benchmark
@@ -412,6 +454,932 @@ public:
                       << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time
                       << std::setw(20) << std::fixed << std::setprecision(0) << ops_per_sec << std::endl;
         }
+        
+        // Deletion patterns: erase picks the gap edge that moves the fewest
+        // elements, so ranges on either side of the gap stay cheap
+        std::cout << std::endl;
+        std::cout << std::left << std::setw(20) << "Erase Pattern" 
+                  << std::right << std::setw(15) << "Time (ms)" 
+                  << std::setw(20) << "Deletions/sec" << std::endl;
+        std::cout << std::string(55, '-') << std::endl;
+        
+        const size_t erase_buffer_size = 1000000;
+        const size_t erase_len = 8;
+        
+        std::vector<std::pair<std::string, int>> erase_patterns = {
+            {"Before Gap", 0},
+            {"After Gap", 1},
+            {"Ping-Pong", 2},
+            {"Random", 3}
+        };
+        
+        for (const auto& pattern : erase_patterns) {
+            gap_buffer<char> test_gb(erase_buffer_size, 'a');
+            size_t cursor = erase_buffer_size / 2;
+            test_gb.insert(test_gb.begin() + cursor, 'x');  // Park the gap at the cursor
+            ++cursor;
+            
+            benchmark_timer timer;
+            timer.start();
+            
+            for (size_t i = 0; i < movements; ++i) {
+                size_t pos;
+                switch (pattern.second) {
+                    case 0:  pos = cursor - erase_len; cursor -= erase_len; break;
+                    case 1:  pos = cursor; break;
+                    case 2:  pos = (i % 2 == 0) ? cursor : cursor - erase_len;
+                             if (i % 2 != 0) cursor -= erase_len;
+                             break;
+                    default: pos = rng() % (test_gb.size() - erase_len); break;
+                }
+                test_gb.erase(test_gb.begin() + pos, test_gb.begin() + pos + erase_len);
+            }
+            
+            double time = timer.stop();
+            double ops_per_sec = (movements * 1000.0) / time;
+            
+            std::cout << std::left << std::setw(20) << pattern.first
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time
+                      << std::setw(20) << std::fixed << std::setprecision(0) << ops_per_sec << std::endl;
+        }
+    }
+    
+    // Large range deletion benchmark
+    void benchmark_range_erase() {
+        print_header("Large Range Deletion Benchmark");
+        std::cout << std::left << std::setw(25) << "Operation" 
+                  << std::right << std::setw(15) << "GapBuffer" 
+                  << std::setw(15) << "std::vector" 
+                  << std::setw(12) << "Ratio" << std::endl;
+        std::cout << std::string(67, '-') << std::endl;
+        
+        const size_t buffer_size = 10000000;
+        const size_t chunk = 65536;
+        const size_t deletions = 50;
+        
+        // Delete chunks just before the gap (cursor-style backspace of a block)
+        {
+            gap_buffer<char> gb(buffer_size, 'a');
+            std::vector<char> vec(buffer_size, 'a');
+            gb.insert(gb.begin() + buffer_size / 2, 'b');  // Park the gap mid-buffer
+            vec.insert(vec.begin() + buffer_size / 2, 'b');
+            
+            benchmark_timer timer;
+            timer.start();
+            for (size_t i = 0; i < deletions; ++i) {
+                size_t pos = buffer_size / 2 - (i + 1) * chunk;
+                gb.erase(gb.begin() + pos, gb.begin() + pos + chunk);
+            }
+            double gap_time = timer.stop();
+            
+            timer.start();
+            for (size_t i = 0; i < deletions; ++i) {
+                size_t pos = buffer_size / 2 - (i + 1) * chunk;
+                vec.erase(vec.begin() + pos, vec.begin() + pos + chunk);
+            }
+            double vector_time = timer.stop();
+            
+            print_result("erase_before_gap", gap_time, vector_time);
+        }
+        
+        // Delete chunks from the front
+        {
+            gap_buffer<char> gb(buffer_size, 'a');
+            std::vector<char> vec(buffer_size, 'a');
+            
+            benchmark_timer timer;
+            timer.start();
+            for (size_t i = 0; i < deletions; ++i) {
+                gb.erase(gb.begin(), gb.begin() + chunk);
+            }
+            double gap_time = timer.stop();
+            
+            timer.start();
+            for (size_t i = 0; i < deletions; ++i) {
+                vec.erase(vec.begin(), vec.begin() + chunk);
+            }
+            double vector_time = timer.stop();
+            
+            print_result("erase_front_chunks", gap_time, vector_time);
+        }
+        
+        // Delete large ranges of non-trivially destructible elements
+        {
+            const size_t string_count = 200000;
+            const size_t string_chunk = 1000;
+            gap_buffer<std::string> gb(string_count, std::string(32, 'x'));
+            std::vector<std::string> vec(string_count, std::string(32, 'x'));
+            
+            benchmark_timer timer;
+            timer.start();
+            for (size_t i = 0; i < deletions; ++i) {
+                size_t pos = gb.size() / 2;
+                gb.erase(gb.begin() + pos, gb.begin() + pos + string_chunk);
+            }
+            double gap_time = timer.stop();
+            
+            timer.start();
+            for (size_t i = 0; i < deletions; ++i) {
+                size_t pos = vec.size() / 2;
+                vec.erase(vec.begin() + pos, vec.begin() + pos + string_chunk);
+            }
+            double vector_time = timer.stop();
+            
+            print_result("erase_string_ranges", gap_time, vector_time);
+        }
+    }
+    
+    // Snapshot (copy) benchmark
+    void benchmark_snapshots() {
+        print_header("Snapshot Copy Benchmark");
+        std::cout << std::left << std::setw(30) << "Operation" 
+                  << std::right << std::setw(15) << "Time (ms)" 
+                  << std::setw(20) << "Copies/sec" << std::endl;
+        std::cout << std::string(65, '-') << std::endl;
+        
+        const size_t doc_size = 1000000;
+        const size_t snapshots = 100;
+        std::string text = generate_random_string(doc_size);
+        
+        auto report = [](const std::string& name, double time, size_t count) {
+            double ops_per_sec = (count * 1000.0) / time;
+            std::cout << std::left << std::setw(30) << name
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time
+                      << std::setw(20) << std::fixed << std::setprecision(0) << ops_per_sec << std::endl;
+        };
+        
+        // Deep copies
+        {
+            gap_buffer<char> gb(text.begin(), text.end());
+            std::vector<gap_buffer<char>> history;
+            history.reserve(snapshots);
+            
+            benchmark_timer timer;
+            timer.start();
+            for (size_t i = 0; i < snapshots; ++i) {
+                history.push_back(gb);
+                gb.insert(gb.begin() + (i * 997) % gb.size(), 'x');
+            }
+            report("gap_buffer_copy", timer.stop(), snapshots);
+            
+            // Dedup-style comparison of neighbouring snapshots, whose gaps
+            // sit at different positions
+            size_t equal_count = 0;  // Keeps the comparisons observable
+            timer.start();
+            for (size_t i = 1; i < history.size(); ++i) {
+                if (history[i - 1] == history[i]) ++equal_count;
+                if (history[i - 1] < history[i]) ++equal_count;
+            }
+            double compare_time = timer.stop();
+            std::cout << std::left << std::setw(30) << "snapshot_compare"
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << compare_time
+                      << std::setw(20) << std::fixed << std::setprecision(0)
+                      << ((history.size() - 1) * 2 * 1000.0) / compare_time
+                      << "  (" << equal_count << " true)" << std::endl;
+        }
+        
+        // Copy-on-write: only the first write after a snapshot copies
+        {
+            cow_gap_buffer<char> gb(text.begin(), text.end());
+            std::vector<cow_gap_buffer<char>> history;
+            history.reserve(snapshots);
+            
+            benchmark_timer timer;
+            timer.start();
+            for (size_t i = 0; i < snapshots; ++i) {
+                history.push_back(gb);
+            }
+            report("cow_gap_buffer_copy", timer.stop(), snapshots);
+            
+            timer.start();
+            for (size_t i = 0; i < snapshots; ++i) {
+                history.push_back(gb);
+                gb.insert((i * 997) % gb.size(), 'x');
+            }
+            report("cow_gap_buffer_copy_write", timer.stop(), snapshots);
+        }
+    }
+    
+    // Bulk resize benchmark
+    void benchmark_resize() {
+        print_header("Resize Benchmark");
+        std::cout << std::left << std::setw(25) << "Operation" 
+                  << std::right << std::setw(15) << "GapBuffer" 
+                  << std::setw(15) << "std::vector" 
+                  << std::setw(12) << "Ratio" << std::endl;
+        std::cout << std::string(67, '-') << std::endl;
+        
+        const size_t large_size = 100 * 1024 * 1024;
+        const size_t truncated_size = 1024 * 1024;
+        
+        // Truncate a 100 MB buffer whose gap sits in the middle
+        {
+            gap_buffer<char> gb(large_size, 'a');
+            std::vector<char> vec(large_size, 'a');
+            gb.insert(gb.begin() + large_size / 2, 'b');
+            vec.insert(vec.begin() + large_size / 2, 'b');
+            
+            benchmark_timer timer;
+            timer.start();
+            gb.resize(truncated_size);
+            double gap_time = timer.stop();
+            
+            timer.start();
+            vec.resize(truncated_size);
+            double vector_time = timer.stop();
+            
+            print_result("truncate_100mb", gap_time, vector_time);
+        }
+        
+        // Grow to 100 MB by value-initialization
+        {
+            gap_buffer<char> gb;
+            std::vector<char> vec;
+            
+            benchmark_timer timer;
+            timer.start();
+            gb.resize(large_size);
+            double gap_time = timer.stop();
+            
+            timer.start();
+            vec.resize(large_size);
+            double vector_time = timer.stop();
+            
+            print_result("grow_to_100mb", gap_time, vector_time);
+        }
+        
+        // Pop the second half of the elements one by one
+        {
+            const size_t count = 10000000;
+            gap_buffer<char> gb(count, 'a');
+            std::vector<char> vec(count, 'a');
+            
+            benchmark_timer timer;
+            timer.start();
+            for (size_t i = 0; i < count / 2; ++i) {
+                gb.pop_back();
+            }
+            double gap_time = timer.stop();
+            
+            timer.start();
+            for (size_t i = 0; i < count / 2; ++i) {
+                vec.pop_back();
+            }
+            double vector_time = timer.stop();
+            
+            print_result("pop_back", gap_time, vector_time);
+        }
+    }
+    
+    // Segmented parallel algorithms on a 1 GB buffer
+    void benchmark_parallel() {
+        print_header("Parallel Algorithms Benchmark (1 GB)");
+        std::cout << std::left << std::setw(12) << "Threads" 
+                  << std::right << std::setw(12) << "count" 
+                  << std::setw(12) << "find" 
+                  << std::setw(12) << "transform" 
+                  << std::setw(12) << "reduce" 
+                  << std::setw(14) << "count GB/s" << std::endl;
+        std::cout << std::string(74, '-') << std::endl;
+        
+        const size_t size = size_t(1) << 30;
+        gap_buffer<char> gb(size, 'a');
+        for (size_t i = 79; i < size; i += 80) {
+            gb[i] = '\n';
+        }
+        // Gap in the middle, match at the very end
+        gb.insert(gb.begin() + size / 2, '\n');
+        gb.push_back('z');
+        
+        benchmark_timer timer;
+        size_t sink = 0;  // Keeps results observable
+        
+        // Baseline: std::count through gap-aware iterators
+        timer.start();
+        sink += std::count(gb.begin(), gb.end(), '\n');
+        double iterator_time = timer.stop();
+        std::cout << std::left << std::setw(12) << "std::count"
+                  << std::right << std::setw(12) << std::fixed << std::setprecision(3) << iterator_time
+                  << std::setw(50) << std::setprecision(2) << (size / 1e9) / (iterator_time / 1000.0) << std::endl;
+        
+        for (unsigned threads : {1u, 2u, 4u, 8u, 16u, 32u}) {
+            timer.start();
+            sink += parallel_count(gb, '\n', threads);
+            double count_time = timer.stop();
+            
+            timer.start();
+            sink += parallel_find(gb, 'z', threads) - gb.begin();
+            double find_time = timer.stop();
+            
+            timer.start();
+            parallel_transform(gb, [](char c) { return c == 'a' ? 'b' : c == 'b' ? 'a' : c; }, threads);
+            double transform_time = timer.stop();
+            
+            timer.start();
+            sink += parallel_reduce(gb, size_t(0), [](size_t a, size_t b) { return a + b; }, threads);
+            double reduce_time = timer.stop();
+            
+            std::cout << std::left << std::setw(12) << threads
+                      << std::right << std::setw(12) << std::fixed << std::setprecision(3) << count_time
+                      << std::setw(12) << find_time
+                      << std::setw(12) << transform_time
+                      << std::setw(12) << reduce_time
+                      << std::setw(14) << std::setprecision(2) << (size / 1e9) / (count_time / 1000.0) << std::endl;
+        }
+        
+        std::cout << "(checksum " << sink << ", " << std::thread::hardware_concurrency() 
+                  << " hardware threads)" << std::endl;
+    }
+    
+    // Large gap moves: plain memmove against non-temporal stores, and the
+    // cost of touching a previously warm working set right afterwards
+    void benchmark_streaming_moves() {
+        print_header("Large Gap Move Benchmark");
+        std::cout << std::left << std::setw(30) << "Move" 
+                  << std::right << std::setw(12) << "Time (ms)" 
+                  << std::setw(10) << "GB/s" 
+                  << std::setw(18) << "Hot set (us)" << std::endl;
+        std::cout << std::string(70, '-') << std::endl;
+        
+        const size_t size = 256 * 1024 * 1024;
+        std::vector<unsigned char> hot(2 * 1024 * 1024, 1);
+        size_t sink = 0;  // Keeps results observable
+        
+        auto touch_hot = [&]() {
+            for (size_t i = 0; i < hot.size(); i += 64) sink += hot[i];
+        };
+        
+        // Insert at target, which moves `moved` bytes of the buffer
+        auto run = [&](const std::string& name, gap_buffer<char>& gb, size_t target, size_t moved,
+                       size_t threshold, unsigned threads) {
+            gap_buffer_tuning::streaming_move_threshold = threshold;
+            gap_buffer_tuning::move_threads = threads;
+            
+            for (int i = 0; i < 4; ++i) touch_hot();
+            
+            benchmark_timer timer;
+            timer.start();
+            gb.insert(gb.begin() + target, 'x');
+            double move_time = timer.stop();
+            
+            timer.start();
+            touch_hot();
+            double hot_time = timer.stop();
+            
+            std::cout << std::left << std::setw(30) << name
+                      << std::right << std::setw(12) << std::fixed << std::setprecision(3) << move_time
+                      << std::setw(10) << std::setprecision(2) << (moved / 1e9) / (move_time / 1000.0)
+                      << std::setw(18) << std::setprecision(1) << hot_time * 1000.0 << std::endl;
+        };
+        
+        const size_t default_threshold = gap_buffer_tuning::streaming_move_threshold;
+        const unsigned default_threads = gap_buffer_tuning::move_threads;
+        const size_t never = static_cast<size_t>(-1);
+        
+        // Whole buffer shifted by a small gap (source and destination overlap)
+        {
+            gap_buffer<char> gb(size, 'a');
+            gb.push_back('b');
+            
+            run("memmove_256mb", gb, 0, gb.size(), never, 1);
+            gb.push_back('b');
+            run("streaming_256mb", gb, 0, gb.size(), 0, 1);
+        }
+        
+        // 64 MB moved across a 192 MB gap (no overlap), optionally threaded
+        {
+            gap_buffer<char> gb(size, 'a');
+            gb.erase(gb.begin() + size / 4, gb.end());
+            size_t half = gb.size();
+            
+            run("memmove_64mb_disjoint", gb, 0, half, never, 1);
+            run("streaming_64mb_disjoint", gb, gb.size(), half, 0, 1);
+            run("streaming_64mb_4_threads", gb, 0, half, 0, 4);
+        }
+        
+        // Tiny moves with streaming and threads forced on: each must fall back
+        // to one thread and still land the right bytes
+        {
+            gap_buffer_tuning::streaming_move_threshold = 0;
+            gap_buffer_tuning::move_threads = 4;
+            
+            gap_buffer<char> gb;
+            std::string expected;
+            benchmark_timer timer;
+            timer.start();
+            const size_t moves = 20000;
+            for (size_t i = 0; i < moves; ++i) {
+                size_t pos = expected.empty() ? 0 : rng() % (expected.size() + 1);
+                char c = static_cast<char>('a' + i % 26);
+                gb.insert(gb.begin() + pos, c);
+                expected.insert(expected.begin() + pos, c);
+                if (expected.size() > 300) {
+                    gb.erase(gb.begin(), gb.begin() + 200);
+                    expected.erase(0, 200);
+                }
+            }
+            double move_time = timer.stop();
+            bool intact = std::equal(gb.begin(), gb.end(), expected.begin(), expected.end());
+            
+            std::cout << std::left << std::setw(30) << "streaming_small_4_threads"
+                      << std::right << std::setw(12) << std::fixed << std::setprecision(3) << move_time
+                      << std::setw(28) << (intact ? "contents ok" : "CONTENTS DIFFER") << std::endl;
+        }
+        
+        gap_buffer_tuning::streaming_move_threshold = default_threshold;
+        gap_buffer_tuning::move_threads = default_threads;
+        std::cout << "(checksum " << sink << ")" << std::endl;
+    }
+    
+    // Soft-wrap index: rebuild on width change, row lookups while scrolling,
+    // and typing with wrapping enabled
+    void benchmark_soft_wrap() {
+        print_header("Soft Wrap Benchmark");
+        std::cout << std::left << std::setw(30) << "Operation" 
+                  << std::right << std::setw(15) << "Time (ms)" 
+                  << std::setw(20) << "Ops/sec" << std::endl;
+        std::cout << std::string(65, '-') << std::endl;
+        
+        auto report = [](const std::string& name, double time, size_t count) {
+            std::cout << std::left << std::setw(30) << name
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time
+                      << std::setw(20) << std::fixed << std::setprecision(0) << (count * 1000.0) / time << std::endl;
+        };
+        
+        const size_t lines = 1000000;
+        std::string text;
+        for (size_t i = 0; i < lines; ++i) {
+            text.append(i % 240, 'x');
+            text += '\n';
+        }
+        text_editor_buffer editor(text);
+        editor.get_line_count();
+        
+        benchmark_timer timer;
+        timer.start();
+        editor.set_wrap_width(80);
+        report("set_wrap_width_1m_lines", timer.stop(), 1);
+        
+        const size_t lookups = 100000;
+        const size_t rows = editor.get_visual_line_count();
+        size_t sink = 0;
+        std::uniform_int_distribution<size_t> row_dist(0, rows - 1);
+        timer.start();
+        for (size_t i = 0; i < lookups; ++i) {
+            sink += editor.position_of_visual_row(row_dist(rng));
+        }
+        report("scroll_to_visual_row", timer.stop(), lookups);
+        
+        const size_t keystrokes = 10000;
+        editor.set_cursor_position(editor.size() / 2);
+        timer.start();
+        for (size_t i = 0; i < keystrokes; ++i) {
+            editor.insert_text(i % 100 == 99 ? "\n" : "y");
+            sink += editor.visual_row_of_position(editor.get_cursor_position());
+        }
+        report("type_with_wrap", timer.stop(), keystrokes);
+        
+        std::cout << "(" << rows << " visual rows, checksum " << sink << ")" << std::endl;
+    }
+    
+    // Follow mode: a writer appends to a log file while the follower pulls
+    // the new bytes in and keeps the line count live
+    void benchmark_follow() {
+        print_header("Log Follow Benchmark");
+        
+        const std::string path = (std::filesystem::temp_directory_path() / "gap_buffer_follow.log").string();
+        const size_t total_bytes = 200 * 1024 * 1024;
+        std::string chunk;
+        for (size_t i = 0; chunk.size() < 1024 * 1024; ++i) {
+            chunk += "2024-01-01T00:00:00Z INFO request handled id=" + std::to_string(i) + "\n";
+        }
+        
+        { std::ofstream create(path, std::ios::binary | std::ios::trunc); }
+        
+        text_editor_buffer editor;
+        file_follower follower(editor);
+        if (!follower.open(path)) {
+            std::cout << "could not open " << path << std::endl;
+            return;
+        }
+        
+        benchmark_timer timer;
+        timer.start();
+        {
+            std::ofstream log(path, std::ios::binary | std::ios::app);
+            for (size_t written = 0; written < total_bytes; written += chunk.size()) {
+                log.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+                log.flush();
+                follower.poll(0);
+                editor.get_line_count();
+            }
+        }
+        while (follower.poll(10) > 0) {}
+        double time = timer.stop();
+        
+        std::cout << "Ingested " << editor.size() / (1024 * 1024) << " MB, "
+                  << editor.get_line_count() << " lines in " << std::fixed << std::setprecision(1) << time << " ms ("
+                  << (editor.size() / 1e6) / (time / 1000.0) << " MB/s, writer included)" << std::endl;
+        
+        // Rotation by unlink + recreate at the same path
+        std::filesystem::remove(path);
+        follower.poll(10);
+        timer.start();
+        std::ofstream(path, std::ios::binary) << chunk;
+        bool rotated = false;
+        for (int i = 0; i < 100 && !rotated; ++i) {
+            follower.poll(10);
+            rotated = editor.size() == chunk.size();
+        }
+        time = timer.stop();
+        std::cout << "Recreated file " << (rotated ? "picked up" : "NOT picked up") << " after "
+                  << std::setprecision(1) << time << " ms" << std::endl;
+        
+        follower.close();
+        std::filesystem::remove(path);
+    }
+    
+    // Streaming ingestion of small chunks with a live line count
+    void benchmark_append() {
+        print_header("Append Ingestion Benchmark");
+        std::cout << std::left << std::setw(30) << "Operation" 
+                  << std::right << std::setw(15) << "Time (ms)" 
+                  << std::setw(15) << "MB/s" << std::endl;
+        std::cout << std::string(60, '-') << std::endl;
+        
+        const size_t chunks = 1000000;
+        std::vector<std::string> lines;
+        for (size_t i = 0; i < 1000; ++i) {
+            lines.push_back("pid 4242: step " + std::to_string(i) + " finished\n");
+        }
+        size_t bytes = 0;
+        for (size_t i = 0; i < chunks; ++i) bytes += lines[i % lines.size()].size();
+        
+        auto report = [&](const std::string& name, double time) {
+            std::cout << std::left << std::setw(30) << name
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time
+                      << std::setw(15) << std::setprecision(1) << (bytes / 1e6) / (time / 1000.0) << std::endl;
+        };
+        
+        size_t sink = 0;  // Keeps the line counts observable
+        benchmark_timer timer;
+        
+        {
+            text_editor_buffer editor;
+            timer.start();
+            for (size_t i = 0; i < chunks; ++i) {
+                editor.insert_text(editor.size(), lines[i % lines.size()]);
+                sink += editor.get_line_count();
+            }
+            report("insert_text_at_end", timer.stop());
+        }
+        
+        {
+            text_editor_buffer editor;
+            timer.start();
+            for (size_t i = 0; i < chunks; ++i) {
+                editor.append(lines[i % lines.size()]);
+                sink += editor.get_line_count();
+            }
+            report("append", timer.stop());
+        }
+        
+        {
+            text_editor_buffer editor;
+            editor.set_max_lines(10000);
+            timer.start();
+            for (size_t i = 0; i < chunks; ++i) {
+                editor.append(lines[i % lines.size()]);
+                sink += editor.get_line_count();
+            }
+            report("append_capped_10k_lines", timer.stop());
+        }
+        
+        std::cout << "(checksum " << sink << ")" << std::endl;
+    }
+    
+    // Capped scrollback: each appended line pushes the oldest one out
+    void benchmark_scrollback() {
+        print_header("Scrollback Trim Benchmark");
+        std::cout << std::left << std::setw(30) << "Operation" 
+                  << std::right << std::setw(15) << "Time (ms)" 
+                  << std::setw(15) << "Lines/s" << std::endl;
+        std::cout << std::string(60, '-') << std::endl;
+        
+        const std::string line = "2024-01-01T00:00:00Z worker[17]: request served in 3ms\n";
+        
+        auto report = [](const std::string& name, size_t lines, double time) {
+            std::cout << std::left << std::setw(30) << name
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time
+                      << std::setw(15) << std::setprecision(0) << lines / (time / 1000.0) << std::endl;
+        };
+        
+        benchmark_timer timer;
+        
+        for (size_t cap : {10000, 100000, 1000000}) {
+            text_editor_buffer editor;
+            editor.set_max_lines(cap);
+            for (size_t i = 0; i < cap; ++i) editor.append(line);
+            
+            const size_t lines = 1000000;
+            timer.start();
+            for (size_t i = 0; i < lines; ++i) {
+                editor.append(line);
+            }
+            report("append_at_cap_" + std::to_string(cap), lines, timer.stop());
+        }
+        
+        // The same FIFO on the raw containers, 64 MB resident
+        const size_t resident = 64 << 20;
+        const size_t chunk = line.size();
+        
+        {
+            gap_buffer<char> gb(resident, 'x');
+            const size_t lines = 1000000;
+            timer.start();
+            for (size_t i = 0; i < lines; ++i) {
+                gb.insert(gb.end(), line.begin(), line.end());
+                gb.erase(gb.begin(), gb.begin() + chunk);
+            }
+            report("gap_buffer_fifo_64MB", lines, timer.stop());
+        }
+        
+        {
+            std::vector<char> vec(resident, 'x');
+            const size_t lines = 200;
+            timer.start();
+            for (size_t i = 0; i < lines; ++i) {
+                vec.insert(vec.end(), line.begin(), line.end());
+                vec.erase(vec.begin(), vec.begin() + chunk);
+            }
+            report("vector_fifo_64MB", lines, timer.stop());
+        }
+    }
+    
+    // Reopening an indexed file: full scan vs. mapped sidecar
+    void benchmark_line_index_sidecar() {
+        print_header("Line Index Sidecar Benchmark");
+        std::cout << std::left << std::setw(30) << "Operation" 
+                  << std::right << std::setw(15) << "Time (ms)" << std::endl;
+        std::cout << std::string(45, '-') << std::endl;
+        
+        const auto dir = std::filesystem::temp_directory_path();
+        const std::string path = (dir / "gap_buffer_sidecar.log").string();
+        const std::string index_path = path + ".lines";
+        {
+            std::ofstream log(path, std::ios::binary | std::ios::trunc);
+            std::string chunk;
+            for (size_t i = 0; chunk.size() < 1024 * 1024; ++i) {
+                chunk += "2024-01-01T00:00:00Z INFO request handled id=" + std::to_string(i) + "\n";
+            }
+            for (size_t written = 0; written < 512u * 1024 * 1024; written += chunk.size()) {
+                log.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            }
+        }
+        
+        auto report = [](const std::string& name, double time) {
+            std::cout << std::left << std::setw(30) << name
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time << std::endl;
+        };
+        
+        benchmark_timer timer;
+        size_t lines = 0;
+        
+        {
+            text_editor_buffer editor;
+            editor.load_from_file(path);
+            timer.start();
+            lines = editor.get_line_count();
+            report("scan_line_index", timer.stop());
+            
+            timer.start();
+            editor.save_line_index(path, index_path);
+            report("save_sidecar", timer.stop());
+        }
+        
+        {
+            text_editor_buffer editor;
+            editor.load_from_file(path);
+            timer.start();
+            bool loaded = editor.load_line_index(path, index_path);
+            report(loaded ? "load_sidecar" : "load_sidecar (rejected)", timer.stop());
+            
+            timer.start();
+            std::string last = editor.get_line(editor.get_line_count() - 2);
+            report("jump_to_last_line", timer.stop());
+        }
+        
+        std::cout << lines << " lines, sidecar " << std::filesystem::file_size(index_path) / (1024 * 1024)
+                  << " MB for " << std::filesystem::file_size(path) / (1024 * 1024) << " MB of text" << std::endl;
+        
+        std::filesystem::remove(path);
+        std::filesystem::remove(index_path);
+    }
+    
+    // Restoring many editor sessions: snapshot files vs. reload + rescan
+    void benchmark_sessions() {
+        print_header("Session Snapshot Benchmark");
+        std::cout << std::left << std::setw(30) << "Operation" 
+                  << std::right << std::setw(15) << "Time (ms)" << std::endl;
+        std::cout << std::string(45, '-') << std::endl;
+        
+        const auto dir = std::filesystem::temp_directory_path();
+        const size_t buffers = 200;
+        const size_t buffer_bytes = 256 * 1024;
+        
+        std::string text;
+        for (size_t i = 0; text.size() < buffer_bytes; ++i) {
+            text += "    value_" + std::to_string(i) + " = compute(value_" + std::to_string(i / 2) + ");\n";
+        }
+        
+        auto text_path = [&](size_t i) { return (dir / ("gap_buffer_session_" + std::to_string(i) + ".txt")).string(); };
+        auto session_path = [&](size_t i) { return (dir / ("gap_buffer_session_" + std::to_string(i) + ".session")).string(); };
+        
+        auto report = [](const std::string& name, double time) {
+            std::cout << std::left << std::setw(30) << name
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time << std::endl;
+        };
+        
+        benchmark_timer timer;
+        
+        {
+            std::vector<text_editor_buffer> editors(buffers);
+            for (size_t i = 0; i < buffers; ++i) {
+                editors[i].insert_text(0, text);
+                editors[i].set_cursor_position(text.size() / 2);
+                editors[i].insert_text("// edited\n");
+                editors[i].add_fold(10, 40);
+                std::ofstream(text_path(i), std::ios::binary) << editors[i].to_string();
+            }
+            
+            timer.start();
+            for (size_t i = 0; i < buffers; ++i) {
+                editors[i].save_session(session_path(i));
+            }
+            report("save_200_sessions", timer.stop());
+        }
+        
+        {
+            std::vector<text_editor_buffer> editors(buffers);
+            timer.start();
+            for (size_t i = 0; i < buffers; ++i) {
+                editors[i].load_from_file(text_path(i));
+                editors[i].get_line_count();
+            }
+            report("reload_and_index_200_files", timer.stop());
+        }
+        
+        {
+            std::vector<text_editor_buffer> editors(buffers);
+            timer.start();
+            for (size_t i = 0; i < buffers; ++i) {
+                editors[i].load_session(session_path(i));
+                editors[i].get_line_count();
+            }
+            report("restore_200_sessions", timer.stop());
+        }
+        
+        for (size_t i = 0; i < buffers; ++i) {
+            std::filesystem::remove(text_path(i));
+            std::filesystem::remove(session_path(i));
+        }
+    }
+    
+    // Cost of journaling keystrokes for crash recovery
+    void benchmark_journal() {
+        print_header("Edit Journal Benchmark");
+        std::cout << std::left << std::setw(30) << "Operation" 
+                  << std::right << std::setw(15) << "Time (ms)" 
+                  << std::setw(15) << "us/edit" << std::endl;
+        std::cout << std::string(60, '-') << std::endl;
+        
+        const auto dir = std::filesystem::temp_directory_path();
+        const std::string base_path = (dir / "gap_buffer_journal.txt").string();
+        const std::string journal_path = (dir / "gap_buffer_journal.txt.journal").string();
+        
+        std::string text;
+        for (size_t i = 0; text.size() < 10 * 1024 * 1024; ++i) {
+            text += "line " + std::to_string(i) + " of the document being edited\n";
+        }
+        std::ofstream(base_path, std::ios::binary) << text;
+        
+        auto report = [](const std::string& name, size_t edits, double time) {
+            std::cout << std::left << std::setw(30) << name
+                      << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time
+                      << std::setw(15) << std::setprecision(3) << time * 1000.0 / edits << std::endl;
+        };
+        
+        // Typing bursts at scattered places, with the odd backspace
+        auto type = [&](text_editor_buffer& editor, size_t edits) {
+            std::uniform_int_distribution<size_t> place(0, editor.size());
+            size_t pos = place(rng);
+            for (size_t i = 0; i < edits; ++i) {
+                if (i % 50 == 0) pos = std::min(place(rng), editor.size());
+                if (i % 7 == 6 && pos > 0) {
+                    editor.delete_text(--pos, 1);
+                } else {
+                    editor.insert_text(pos++, std::string(1, 'a' + static_cast<char>(i % 26)));
+                }
+            }
+        };
+        
+        benchmark_timer timer;
+        const size_t edits = 200000;
+        
+        {
+            text_editor_buffer editor;
+            editor.load_from_file(base_path);
+            timer.start();
+            type(editor, edits);
+            report("no_journal", edits, timer.stop());
+        }
+        
+        {
+            text_editor_buffer editor;
+            editor.load_from_file(base_path);
+            edit_journal journal;
+            journal.open(journal_path, base_path);
+            editor.set_journal(&journal);
+            timer.start();
+            type(editor, edits);
+            journal.sync();
+            report("journal_batched_100ms", edits, timer.stop());
+        }
+        
+        {
+            const size_t synced_edits = 2000;
+            text_editor_buffer editor;
+            editor.load_from_file(base_path);
+            edit_journal journal;
+            journal.set_sync_policy(0, std::chrono::milliseconds(0));
+            journal.open(journal_path, base_path);
+            editor.set_journal(&journal);
+            timer.start();
+            type(editor, synced_edits);
+            report("journal_fsync_each_edit", synced_edits, timer.stop());
+            
+            text_editor_buffer recovered;
+            timer.start();
+            recovered.recover_from_journal(base_path, journal_path);
+            report("recover_2000_edits", synced_edits, timer.stop());
+        }
+        
+        std::filesystem::remove(base_path);
+        std::filesystem::remove(journal_path);
+    }
+    
+    // Load/save throughput of plain and compressed files (codecs as built in)
+    void benchmark_compressed_io() {
+        print_header("Compressed File I/O Benchmark");
+        std::cout << std::left << std::setw(30) << "Operation" 
+                  << std::right << std::setw(15) << "Time (ms)" 
+                  << std::setw(15) << "MB/s" 
+                  << std::setw(15) << "File (MB)" << std::endl;
+        std::cout << std::string(75, '-') << std::endl;
+        
+        const auto dir = std::filesystem::temp_directory_path();
+        
+        std::string text;
+        for (size_t i = 0; text.size() < 128 * 1024 * 1024; ++i) {
+            text += "2024-05-01T12:00:" + std::to_string(i % 60) + " INFO request " + std::to_string(i) +
+                    " served in " + std::to_string(rng() % 1000) + "us\n";
+        }
+        const double mb = text.size() / (1024.0 * 1024.0);
+        
+        text_editor_buffer editor;
+        editor.insert_text(0, text);
+        editor.set_cursor_position(text.size() / 2);
+        editor.insert_text("edited\n");  // Gap in the middle
+        
+        std::vector<std::string> suffixes = {".log"};
+#ifdef GAP_BUFFER_USE_ZLIB
+        suffixes.push_back(".log.gz");
+#endif
+#ifdef GAP_BUFFER_USE_ZSTD
+        suffixes.push_back(".log.zst");
+#endif
+        
+        benchmark_timer timer;
+        for (const auto& suffix : suffixes) {
+            const std::string path = (dir / ("gap_buffer_compressed" + suffix)).string();
+            auto report = [&](const std::string& name, double time) {
+                std::cout << std::left << std::setw(30) << name
+                          << std::right << std::setw(15) << std::fixed << std::setprecision(3) << time
+                          << std::setw(15) << std::setprecision(1) << mb * 1000.0 / time
+                          << std::setw(15) << std::filesystem::file_size(path) / (1024.0 * 1024.0) << std::endl;
+            };
+            
+            timer.start();
+            editor.save_to_file(path);
+            report("save" + suffix, timer.stop());
+            
+            text_editor_buffer loaded;
+            timer.start();
+            loaded.load_from_file(path);
+            report("load" + suffix, timer.stop());
+            
+            std::filesystem::remove(path);
+        }
     }
     
     void run_all_benchmarks() {
@@ -422,6 +1390,19 @@ public:
         benchmark_text_editor();
         benchmark_memory_usage();
         benchmark_gap_movement();
+        benchmark_range_erase();
+        benchmark_snapshots();
+        benchmark_resize();
+        benchmark_parallel();
+        benchmark_streaming_moves();
+        benchmark_soft_wrap();
+        benchmark_follow();
+        benchmark_append();
+        benchmark_scrollback();
+        benchmark_line_index_sidecar();
+        benchmark_sessions();
+        benchmark_journal();
+        benchmark_compressed_io();
         
         std::cout << "\nBenchmark completed." << std::endl;
     }
@@ -9,13 +9,73 @@
 #include <initializer_list>
 #include <type_traits>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <regex>
 #include <functional>
 #include <fstream>
 #include <iostream>
+#include <streambuf>
 #include <iomanip>
 #include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <filesystem>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+// Compressed files are read and written transparently when built with
+// -DGAP_BUFFER_USE_ZLIB (link -lz) and/or -DGAP_BUFFER_USE_ZSTD (link -lzstd)
+#ifdef GAP_BUFFER_USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef GAP_BUFFER_USE_ZSTD
+#include <zstd.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GAP_BUFFER_HAS_SSE2 1
+#endif
+
+// gap_buffer is usable in constant expressions when the compiler supports
+// C++20 constexpr allocation; otherwise the annotation expands to nothing.
+#if defined(__cpp_constexpr_dynamic_alloc) && defined(__cpp_lib_constexpr_dynamic_alloc)
+#define GAP_BUFFER_CONSTEXPR constexpr
+#else
+#define GAP_BUFFER_CONSTEXPR
+#endif
+
+// Tag selecting the constructors that take ownership of existing storage
+struct adopt_storage_t {
+    explicit adopt_storage_t() = default;
+};
+inline constexpr adopt_storage_t adopt_storage{};
+
+// Process-wide tuning knobs. Gap moves of at least streaming_move_threshold
+// bytes (trivially copyable elements, SSE2 targets) bypass the cache with
+// non-temporal stores, so relocating hundreds of MB does not evict the
+// working set. When the source and destination do not overlap, such a move
+// is split across move_threads threads.
+struct gap_buffer_tuning {
+    static inline size_t streaming_move_threshold = size_t(8) << 20;
+    static inline unsigned move_threads = 1;
+};
 
 template <typename T, typename Allocator = std::allocator<T>>
 class gap_buffer {
@@ -25,6 +85,9 @@ protected:  // privateからprotectedに変更
     size_t gap_start;
     size_t gap_end;
     size_t buffer_size;
+    // Slots before buffer given up by front erases; the allocation starts
+    // at buffer - front_space
+    size_t front_space;
 
     // RAII helper for exception safety
     class buffer_guard {
@@ -33,88 +96,412 @@ protected:  // privateからprotectedに変更
         T* buffer_;
         size_t capacity_;
         size_t constructed_count_;
+        size_t tail_start_;
+        size_t tail_count_;
         
     public:
-        buffer_guard(Allocator& alloc, T* buf, size_t cap) 
-            : alloc_(alloc), buffer_(buf), capacity_(cap), constructed_count_(0) {}
+        GAP_BUFFER_CONSTEXPR buffer_guard(Allocator& alloc, T* buf, size_t cap) 
+            : alloc_(alloc), buffer_(buf), capacity_(cap), constructed_count_(0),
+              tail_start_(cap), tail_count_(0) {}
 	buffer_guard(const buffer_guard&) = delete;
 	buffer_guard& operator=(const buffer_guard&) = delete;
         
-        ~buffer_guard() {
+        GAP_BUFFER_CONSTEXPR ~buffer_guard() {
             if (buffer_) {
                 // Destroy constructed elements
                 for (size_t i = 0; i < constructed_count_; ++i) {
                     std::allocator_traits<Allocator>::destroy(alloc_, buffer_ + i);
                 }
+                for (size_t i = 0; i < tail_count_; ++i) {
+                    std::allocator_traits<Allocator>::destroy(alloc_, buffer_ + tail_start_ + i);
+                }
                 std::allocator_traits<Allocator>::deallocate(alloc_, buffer_, capacity_);
             }
         }
         
-        void increment_constructed() { ++constructed_count_; }
-        void release() { buffer_ = nullptr; }
-        T* get() const { return buffer_; }
+        GAP_BUFFER_CONSTEXPR void increment_constructed(size_t n = 1) { constructed_count_ += n; }
+        GAP_BUFFER_CONSTEXPR void set_tail(size_t start) { tail_start_ = start; }
+        GAP_BUFFER_CONSTEXPR void increment_tail(size_t n = 1) { tail_count_ += n; }
+        GAP_BUFFER_CONSTEXPR void release() { buffer_ = nullptr; }
+        GAP_BUFFER_CONSTEXPR T* get() const { return buffer_; }
     };
 
+    static GAP_BUFFER_CONSTEXPR bool is_constant_evaluated() noexcept {
+#ifdef __cpp_lib_is_constant_evaluated
+        return std::is_constant_evaluated();
+#else
+        return false;
+#endif
+    }
+
+    // Destroy [first, last); a no-op for trivially destructible types
+    GAP_BUFFER_CONSTEXPR void destroy_range(T* first, T* last) {
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            if constexpr (std::is_same<Allocator, std::allocator<T>>::value) {
+                std::destroy(first, last);
+            } else {
+                for (; first != last; ++first) {
+                    std::allocator_traits<Allocator>::destroy(alloc, first);
+                }
+            }
+        }
+    }
+
+    // Relocate count elements from src to dst (the ranges may overlap).
+    // Destination slots are raw storage and source slots become raw storage,
+    // so objects are move-constructed and destroyed rather than assigned.
+#ifdef GAP_BUFFER_HAS_SSE2
+    // Copy with streaming stores from the front; safe when dst <= src even if
+    // the ranges overlap, since each 64-byte block is loaded before it is
+    // stored and stores never reach unread source bytes
+    static void stream_forward(unsigned char* dst, const unsigned char* src, size_t bytes) {
+        size_t head = std::min(bytes, (16 - reinterpret_cast<std::uintptr_t>(dst) % 16) % 16);
+        std::memmove(dst, src, head);
+        dst += head;
+        src += head;
+        bytes -= head;
+        
+        for (; bytes >= 64; bytes -= 64, src += 64, dst += 64) {
+            _mm_prefetch(reinterpret_cast<const char*>(src) + 512, _MM_HINT_NTA);
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+        }
+        _mm_sfence();
+        
+        std::memmove(dst, src, bytes);
+    }
+    
+    // Mirror image of stream_forward for dst > src
+    static void stream_backward(unsigned char* dst, const unsigned char* src, size_t bytes) {
+        size_t tail = std::min(bytes, static_cast<size_t>(reinterpret_cast<std::uintptr_t>(dst + bytes) % 16));
+        bytes -= tail;
+        std::memmove(dst + bytes, src + bytes, tail);
+        
+        for (; bytes >= 64; bytes -= 64) {
+            const unsigned char* from = src + bytes - 64;
+            unsigned char* to = dst + bytes - 64;
+            _mm_prefetch(reinterpret_cast<const char*>(from) - 512, _MM_HINT_NTA);
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + 32));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + 48));
+            _mm_stream_si128(reinterpret_cast<__m128i*>(to), a);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(to + 16), b);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(to + 32), c);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(to + 48), d);
+        }
+        _mm_sfence();
+        
+        std::memmove(dst, src, bytes);
+    }
+    
+    // memmove replacement for large relocations that leaves the cache alone
+    static void streaming_move(unsigned char* dst, const unsigned char* src, size_t bytes) {
+        bool disjoint = dst + bytes <= src || src + bytes <= dst;
+        unsigned threads = gap_buffer_tuning::move_threads;
+        
+        // Each worker gets at least one 64-byte block
+        if (disjoint && threads > 1 && bytes >= size_t(threads) * 64) {
+            size_t part = std::max<size_t>((bytes / threads + 63) & ~size_t(63), 64);
+            std::vector<std::thread> workers;
+            for (size_t offset = part; offset < bytes; offset += part) {
+                size_t len = std::min(part, bytes - offset);
+                try {
+                    workers.emplace_back(stream_forward, dst + offset, src + offset, len);
+                } catch (...) {
+                    stream_forward(dst + offset, src + offset, len);
+                }
+            }
+            stream_forward(dst, src, std::min(part, bytes));
+            for (auto& worker : workers) worker.join();
+            return;
+        }
+        
+        if (dst < src) {
+            stream_forward(dst, src, bytes);
+        } else {
+            stream_backward(dst, src, bytes);
+        }
+    }
+#endif
+
+    GAP_BUFFER_CONSTEXPR void relocate(T* src, size_t count, T* dst) {
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            if (!is_constant_evaluated()) {
+#ifdef GAP_BUFFER_HAS_SSE2
+                if (count * sizeof(T) >= gap_buffer_tuning::streaming_move_threshold) {
+                    streaming_move(reinterpret_cast<unsigned char*>(dst),
+                                   reinterpret_cast<const unsigned char*>(src), count * sizeof(T));
+                    return;
+                }
+#endif
+                std::memmove(static_cast<void*>(dst), static_cast<const void*>(src), count * sizeof(T));
+                return;
+            }
+        }
+        
+        if (dst > src) {
+            for (size_t i = count; i > 0; --i) {
+                std::allocator_traits<Allocator>::construct(alloc, dst + i - 1, std::move(src[i - 1]));
+                std::allocator_traits<Allocator>::destroy(alloc, src + i - 1);
+            }
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                std::allocator_traits<Allocator>::construct(alloc, dst + i, std::move(src[i]));
+                std::allocator_traits<Allocator>::destroy(alloc, src + i);
+            }
+        }
+    }
+
     // Move the gap to a specified position
-    void move_gap(size_t pos) {
+    GAP_BUFFER_CONSTEXPR void move_gap(size_t pos) {
         if (pos == gap_start) return;
         
+        size_t gap_size = gap_end - gap_start;
+        if (gap_size == 0) {
+            gap_start = gap_end = pos;
+            return;
+        }
+        
         if (pos < gap_start) {
             // Move Gap Left
             size_t count = gap_start - pos;
-            std::move_backward(buffer + pos, buffer + gap_start, buffer + gap_end);
+            relocate(buffer + pos, count, buffer + pos + gap_size);
             gap_end -= count;
             gap_start -= count;
         } else {
             // Move Gap Right
             size_t count = pos - gap_start;
-            std::move(buffer + gap_end, buffer + gap_end + count, buffer + gap_start);
+            relocate(buffer + gap_end, count, buffer + gap_start);
             gap_start += count;
             gap_end += count;
         }
     }
 
-    // Increase the gap size with exception safety
-    void grow(size_t min_capacity = 0) {
+    // Types whose equality is bitwise equality, and types whose ordering is
+    // the unsigned byte order memcmp uses
+    static constexpr bool bitwise_equality =
+        std::is_integral<T>::value || std::is_pointer<T>::value || std::is_same<T, std::byte>::value;
+    static constexpr bool bytewise_ordering =
+        sizeof(T) == 1 && (std::is_unsigned<T>::value || std::is_same<T, std::byte>::value);
+
+    // Walk the first n elements of both buffers in runs that are contiguous
+    // in both (at most three, wherever either gap falls). fn(a, b, len)
+    // returns non-zero to stop the walk with that result.
+    template <typename Fn>
+    GAP_BUFFER_CONSTEXPR int compare_runs(const gap_buffer& other, size_t n, Fn fn) const {
+        size_t i = 0;
+        while (i < n) {
+            size_t len = n - i;
+            if (i < gap_start) len = std::min(len, gap_start - i);
+            if (i < other.gap_start) len = std::min(len, other.gap_start - i);
+            
+            const T* a = buffer + (i < gap_start ? i : i + (gap_end - gap_start));
+            const T* b = other.buffer + (i < other.gap_start ? i : i + (other.gap_end - other.gap_start));
+            int result = fn(a, b, len);
+            if (result != 0) return result;
+            i += len;
+        }
+        return 0;
+    }
+
+    // Iterators whose elements can be copied with memcpy
+    template <typename It>
+    static constexpr bool is_contiguous_source() {
+        using source_type = std::remove_cv_t<std::remove_reference_t<decltype(*std::declval<It>())>>;
+        if constexpr (!std::is_trivially_copyable<T>::value || !std::is_same<source_type, T>::value) {
+            return false;
+        } else {
+#ifdef __cpp_lib_concepts
+            return std::contiguous_iterator<It>;
+#else
+            return std::is_pointer<It>::value;
+#endif
+        }
+    }
+
+    // Construct count elements from first at the start of the gap, which
+    // must have room for them. gap_start advances per element, so a throwing
+    // constructor leaves the buffer consistent.
+    template <typename It>
+    GAP_BUFFER_CONSTEXPR void construct_at_gap(It first, size_t count) {
+        if constexpr (is_contiguous_source<It>()) {
+            if (!is_constant_evaluated()) {
+                if (count > 0) {
+                    std::memcpy(static_cast<void*>(buffer + gap_start),
+                                static_cast<const void*>(std::addressof(*first)), count * sizeof(T));
+                }
+                gap_start += count;
+                return;
+            }
+        }
+        
+        for (size_t i = 0; i < count; ++i, ++first) {
+            std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, *first);
+            ++gap_start;
+        }
+    }
+
+    // Value-initialize count elements at the start of the gap
+    GAP_BUFFER_CONSTEXPR void value_construct_at_gap(size_t count) {
+        if constexpr (std::is_arithmetic<T>::value) {
+            if (!is_constant_evaluated()) {
+                if (count > 0) {
+                    std::memset(static_cast<void*>(buffer + gap_start), 0, count * sizeof(T));
+                }
+                gap_start += count;
+                return;
+            }
+        }
+        
+        for (size_t i = 0; i < count; ++i) {
+            std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start);
+            ++gap_start;
+        }
+    }
+
+    // Construct count copies of value at the start of the gap
+    GAP_BUFFER_CONSTEXPR void fill_at_gap(size_t count, const T& value) {
+        if constexpr (sizeof(T) == 1 && std::is_trivially_copyable<T>::value) {
+            if (!is_constant_evaluated()) {
+                unsigned char byte;
+                std::memcpy(&byte, std::addressof(value), 1);
+                if (count > 0) {
+                    std::memset(static_cast<void*>(buffer + gap_start), byte, count);
+                }
+                gap_start += count;
+                return;
+            }
+        }
+        
+        for (size_t i = 0; i < count; ++i) {
+            std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, value);
+            ++gap_start;
+        }
+    }
+
+    GAP_BUFFER_CONSTEXPR void deallocate_storage() {
+        std::allocator_traits<Allocator>::deallocate(alloc, buffer - front_space, buffer_size + front_space);
+    }
+    
+    // Slide the elements before the gap down over the front space, which
+    // becomes part of the gap
+    GAP_BUFFER_CONSTEXPR void reclaim_front_space() {
+        if (front_space == 0) return;
+        relocate(buffer, gap_start, buffer - front_space);
+        buffer -= front_space;
+        gap_end += front_space;
+        buffer_size += front_space;
+        front_space = 0;
+    }
+
+    // Replace the storage of an empty buffer with exactly new_capacity slots
+    GAP_BUFFER_CONSTEXPR void reset_storage(size_t new_capacity) {
+        T* new_buffer = alloc.allocate(new_capacity);
+        if (buffer) {
+            deallocate_storage();
+        }
+        buffer = new_buffer;
+        buffer_size = new_capacity;
+        front_space = 0;
+        gap_start = 0;
+        gap_end = new_capacity;
+    }
+
+    // Fill an empty buffer with a copy of other, reusing the storage when it
+    // is large enough and allocating exactly once otherwise
+    GAP_BUFFER_CONSTEXPR void copy_from(const gap_buffer& other) {
+        size_t count = other.size();
+        if (count > buffer_size) {
+            reset_storage(count);
+        }
+        construct_at_gap(static_cast<const T*>(other.buffer), other.gap_start);
+        construct_at_gap(static_cast<const T*>(other.buffer + other.gap_end), other.buffer_size - other.gap_end);
+    }
+
+    // Reallocate with room for at least min_capacity elements. The gap is
+    // placed at logical position pos while copying, so callers that need the
+    // gap somewhere else never pay for a separate move_gap.
+    GAP_BUFFER_CONSTEXPR void grow_at(size_t pos, size_t min_capacity = 0) {
         size_t old_size = size();
+        size_t old_gap = gap_end - gap_start;
         size_t new_capacity = buffer_size == 0 ? 16 : buffer_size * 2;
-        if (min_capacity > 0 && new_capacity < min_capacity)
+        if (new_capacity < min_capacity)
             new_capacity = min_capacity;
+        size_t new_gap = new_capacity - old_size;
         
         T* new_buffer = alloc.allocate(new_capacity);
         buffer_guard guard(alloc, new_buffer, new_capacity);
-        
-        // Copy data from old buffer with exception safety
-        if (buffer && old_size > 0) {
-            // Copy elements before gap
-            size_t before_gap = gap_start;
-            for (size_t i = 0; i < before_gap; ++i) {
-                std::allocator_traits<Allocator>::construct(alloc, new_buffer + i, std::move_if_noexcept(buffer[i]));
-                guard.increment_constructed();
+        guard.set_tail(pos + new_gap);
+        
+        // Copy logical elements [first, last), which lie on one side of both
+        // the old gap and pos, with exception safety
+        auto copy_run = [&](size_t first, size_t last) {
+            if (first >= last) return;
+            size_t count = last - first;
+            bool tail = first >= pos;
+            T* src = buffer + (first < gap_start ? first : first + old_gap);
+            T* dst = new_buffer + (tail ? first + new_gap : first);
+            
+            if constexpr (std::is_trivially_copyable<T>::value) {
+                if (!is_constant_evaluated()) {
+                    std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), count * sizeof(T));
+                    tail ? guard.increment_tail(count) : guard.increment_constructed(count);
+                    return;
+                }
             }
             
-            // Copy elements after gap
-            size_t after_gap = buffer_size - gap_end;
-            for (size_t i = 0; i < after_gap; ++i) {
-                std::allocator_traits<Allocator>::construct(alloc, new_buffer + before_gap + i, 
-                                                            std::move_if_noexcept(buffer[gap_end + i]));
-                guard.increment_constructed();
+            for (size_t i = 0; i < count; ++i) {
+                std::allocator_traits<Allocator>::construct(alloc, dst + i, std::move_if_noexcept(src[i]));
+                tail ? guard.increment_tail() : guard.increment_constructed();
             }
-        }
+        };
         
-        // Destroy old buffer
         if (buffer) {
-            for (size_t i = 0; i < gap_start; ++i)
-                std::allocator_traits<Allocator>::destroy(alloc, buffer + i);
-            for (size_t i = gap_end; i < buffer_size; ++i)
-                std::allocator_traits<Allocator>::destroy(alloc, buffer + i);
-            std::allocator_traits<Allocator>::deallocate(alloc, buffer, buffer_size);
+            size_t lo = std::min(pos, gap_start);
+            size_t hi = std::max(pos, gap_start);
+            copy_run(0, lo);
+            copy_run(lo, hi);
+            copy_run(hi, old_size);
+            
+            // Destroy old buffer
+            destroy_range(buffer, buffer + gap_start);
+            destroy_range(buffer + gap_end, buffer + buffer_size);
+            deallocate_storage();
         }
         
         buffer = guard.get();
         guard.release();
-        gap_end = gap_start + (new_capacity - old_size);
+        gap_start = pos;
+        gap_end = pos + new_gap;
         buffer_size = new_capacity;
+        front_space = 0;
+    }
+    
+    // Increase the gap size with exception safety
+    GAP_BUFFER_CONSTEXPR void grow(size_t min_capacity = 0) {
+        grow_at(gap_start, min_capacity);
+    }
+    
+    // Make room for count elements at position, moving as few existing
+    // elements as possible. Front space is taken back only once it is at
+    // least as large as the elements that must slide over it, which keeps
+    // trimming the front and appending at the back O(1) amortized.
+    GAP_BUFFER_CONSTEXPR void open_gap(size_t position, size_t count) {
+        if (gap_end - gap_start >= count) {
+            move_gap(position);
+        } else if (front_space >= size() && gap_end - gap_start + front_space >= count) {
+            reclaim_front_space();
+            move_gap(position);
+        } else {
+            grow_at(position, size() + count);
+        }
     }
 
 public:
@@ -139,14 +526,14 @@ public:
         size_t gap_end;
         size_t buffer_size;
         
-        iterator_impl(buffer_ptr buff, size_t p, size_t gs, size_t ge, size_t bs)
+        GAP_BUFFER_CONSTEXPR iterator_impl(buffer_ptr buff, size_t p, size_t gs, size_t ge, size_t bs)
             : buffer(buff), pos(p), gap_start(gs), gap_end(ge), buffer_size(bs) {}
         
-        size_t real_pos() const {
+        GAP_BUFFER_CONSTEXPR size_t real_pos() const {
             return pos >= gap_start ? pos + (gap_end - gap_start) : pos;
         }
         
-        void check_bounds() const {
+        GAP_BUFFER_CONSTEXPR void check_bounds() const {
             if (!buffer || pos > buffer_size - (gap_end - gap_start)) {
                 throw std::out_of_range("gap_buffer iterator out of bounds");
             }
@@ -154,100 +541,105 @@ public:
         
     public:
         using iterator_category = std::random_access_iterator_tag;
-        using value_type = std::conditional_t<IsConst, const T, T>;
+        using iterator_concept = std::random_access_iterator_tag;
+        using value_type = std::remove_cv_t<T>;
         using difference_type = std::ptrdiff_t;
-        using pointer = value_type*;
-        using reference = value_type&;
+        using pointer = std::conditional_t<IsConst, const T*, T*>;
+        using reference = std::conditional_t<IsConst, const T&, T&>;
         
-        iterator_impl() : buffer(nullptr), pos(0), gap_start(0), gap_end(0), buffer_size(0) {}
+        GAP_BUFFER_CONSTEXPR iterator_impl() : buffer(nullptr), pos(0), gap_start(0), gap_end(0), buffer_size(0) {}
         
         // Conversion constructor from non-const to const
         template <bool IsConst2 = IsConst, typename = std::enable_if_t<IsConst2>>
-        iterator_impl(const iterator_impl<false>& other)
+        GAP_BUFFER_CONSTEXPR iterator_impl(const iterator_impl<false>& other)
             : buffer(other.buffer), pos(other.pos), gap_start(other.gap_start), 
               gap_end(other.gap_end), buffer_size(other.buffer_size) {}
         
-        reference operator*() const {
+        GAP_BUFFER_CONSTEXPR reference operator*() const {
             check_bounds();
             return buffer[real_pos()];
         }
         
-        pointer operator->() const {
+        GAP_BUFFER_CONSTEXPR pointer operator->() const {
             check_bounds();
             return &buffer[real_pos()];
         }
         
-        iterator_impl& operator++() {
+        GAP_BUFFER_CONSTEXPR iterator_impl& operator++() {
             ++pos;
             return *this;
         }
         
-        iterator_impl operator++(int) {
+        GAP_BUFFER_CONSTEXPR iterator_impl operator++(int) {
             iterator_impl tmp = *this;
             ++*this;
             return tmp;
         }
         
-        iterator_impl& operator--() {
+        GAP_BUFFER_CONSTEXPR iterator_impl& operator--() {
             --pos;
             return *this;
         }
         
-        iterator_impl operator--(int) {
+        GAP_BUFFER_CONSTEXPR iterator_impl operator--(int) {
             iterator_impl tmp = *this;
             --*this;
             return tmp;
         }
         
-        iterator_impl& operator+=(difference_type n) {
+        GAP_BUFFER_CONSTEXPR iterator_impl& operator+=(difference_type n) {
             pos += n;
             return *this;
         }
         
-        iterator_impl operator+(difference_type n) const {
+        GAP_BUFFER_CONSTEXPR iterator_impl operator+(difference_type n) const {
             iterator_impl tmp = *this;
             return tmp += n;
         }
         
-        iterator_impl& operator-=(difference_type n) {
+        friend GAP_BUFFER_CONSTEXPR iterator_impl operator+(difference_type n, const iterator_impl& it) {
+            return it + n;
+        }
+        
+        GAP_BUFFER_CONSTEXPR iterator_impl& operator-=(difference_type n) {
             pos -= n;
             return *this;
         }
         
-        iterator_impl operator-(difference_type n) const {
+        GAP_BUFFER_CONSTEXPR iterator_impl operator-(difference_type n) const {
             iterator_impl tmp = *this;
             return tmp -= n;
         }
         
-        difference_type operator-(const iterator_impl& other) const {
+        GAP_BUFFER_CONSTEXPR difference_type operator-(const iterator_impl& other) const {
             return static_cast<difference_type>(pos) - static_cast<difference_type>(other.pos);
         }
         
-        reference operator[](difference_type n) const {
+        GAP_BUFFER_CONSTEXPR reference operator[](difference_type n) const {
             return *(*this + n);
         }
         
-        bool operator==(const iterator_impl& other) const {
+        GAP_BUFFER_CONSTEXPR bool operator==(const iterator_impl& other) const {
             return buffer == other.buffer && pos == other.pos;
         }
         
-        bool operator!=(const iterator_impl& other) const {
+        GAP_BUFFER_CONSTEXPR bool operator!=(const iterator_impl& other) const {
             return !(*this == other);
         }
         
-        bool operator<(const iterator_impl& other) const {
+        GAP_BUFFER_CONSTEXPR bool operator<(const iterator_impl& other) const {
             return buffer == other.buffer && pos < other.pos;
         }
         
-        bool operator>(const iterator_impl& other) const {
+        GAP_BUFFER_CONSTEXPR bool operator>(const iterator_impl& other) const {
             return other < *this;
         }
         
-        bool operator<=(const iterator_impl& other) const {
+        GAP_BUFFER_CONSTEXPR bool operator<=(const iterator_impl& other) const {
             return !(other < *this);
         }
         
-        bool operator>=(const iterator_impl& other) const {
+        GAP_BUFFER_CONSTEXPR bool operator>=(const iterator_impl& other) const {
             return !(*this < other);
         }
         
@@ -259,72 +651,132 @@ public:
     using const_iterator = iterator_impl<true>;
     using reverse_iterator = std::reverse_iterator<iterator>;
     using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    
+    // Contiguous piece of the contents, as returned by segments()
+#ifdef __cpp_lib_span
+    using segment = std::span<T>;
+    using const_segment = std::span<const T>;
+#else
+    template <typename U>
+    class segment_view {
+    private:
+        U* first;
+        size_type count;
+        
+    public:
+        constexpr segment_view() noexcept : first(nullptr), count(0) {}
+        constexpr segment_view(U* data, size_type size) noexcept : first(data), count(size) {}
+        
+        constexpr U* data() const noexcept { return first; }
+        constexpr size_type size() const noexcept { return count; }
+        constexpr bool empty() const noexcept { return count == 0; }
+        constexpr U* begin() const noexcept { return first; }
+        constexpr U* end() const noexcept { return first + count; }
+        constexpr U& operator[](size_type i) const { return first[i]; }
+    };
+    
+    using segment = segment_view<T>;
+    using const_segment = segment_view<const T>;
+#endif
 
     // Constructors
-    gap_buffer() : alloc(), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0) {}
+    GAP_BUFFER_CONSTEXPR gap_buffer() : alloc(), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0), front_space(0) {}
     
-    explicit gap_buffer(const Allocator& alloc_) 
-        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0) {}
+    GAP_BUFFER_CONSTEXPR explicit gap_buffer(const Allocator& alloc_) 
+        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0), front_space(0) {}
     
-    gap_buffer(size_type count, const T& value, const Allocator& alloc_ = Allocator())
-        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0) {
+    GAP_BUFFER_CONSTEXPR gap_buffer(size_type count, const T& value, const Allocator& alloc_ = Allocator())
+        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0), front_space(0) {
         assign(count, value);
     }
     
-    explicit gap_buffer(size_type count, const Allocator& alloc_ = Allocator())
-        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0) {
+    GAP_BUFFER_CONSTEXPR explicit gap_buffer(size_type count, const Allocator& alloc_ = Allocator())
+        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0), front_space(0) {
         resize(count);
     }
     
     template <typename InputIt, typename = 
               std::enable_if_t<!std::is_integral<InputIt>::value>>
-    gap_buffer(InputIt first, InputIt last, const Allocator& alloc_ = Allocator())
-        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0) {
+    GAP_BUFFER_CONSTEXPR gap_buffer(InputIt first, InputIt last, const Allocator& alloc_ = Allocator())
+        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0), front_space(0) {
         assign(first, last);
     }
     
-    gap_buffer(const gap_buffer& other)
+    GAP_BUFFER_CONSTEXPR gap_buffer(const gap_buffer& other)
         : alloc(std::allocator_traits<Allocator>::select_on_container_copy_construction(other.alloc)),
-          buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0) {
-        assign(other.begin(), other.end());
+          buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0), front_space(0) {
+        copy_from(other);
     }
     
-    gap_buffer(gap_buffer&& other) noexcept
+    GAP_BUFFER_CONSTEXPR gap_buffer(gap_buffer&& other) noexcept
         : alloc(std::move(other.alloc)), buffer(other.buffer), 
-          gap_start(other.gap_start), gap_end(other.gap_end), buffer_size(other.buffer_size) {
+          gap_start(other.gap_start), gap_end(other.gap_end), buffer_size(other.buffer_size),
+          front_space(other.front_space) {
         other.buffer = nullptr;
         other.gap_start = 0;
         other.gap_end = 0;
         other.buffer_size = 0;
+        other.front_space = 0;
     }
     
-    gap_buffer(std::initializer_list<T> init, const Allocator& alloc_ = Allocator())
-        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0) {
+    GAP_BUFFER_CONSTEXPR gap_buffer(std::initializer_list<T> init, const Allocator& alloc_ = Allocator())
+        : alloc(alloc_), buffer(nullptr), gap_start(0), gap_end(0), buffer_size(0), front_space(0) {
         assign(init);
     }
     
+    // Raw storage exchanged by the adopting constructor and release():
+    // data[0, size) holds constructed elements, data[size, capacity) is
+    // unconstructed, and the block belongs to (a copy of) the allocator
+    struct storage_block {
+        T* data;
+        size_type size;
+        size_type capacity;
+    };
+    
+    // Take ownership of storage allocated with alloc_ without copying it;
+    // the gap starts out as the unused tail
+    GAP_BUFFER_CONSTEXPR gap_buffer(adopt_storage_t, T* data, size_type count, size_type capacity,
+                                    const Allocator& alloc_ = Allocator())
+        : alloc(alloc_), buffer(data), gap_start(count), gap_end(capacity), buffer_size(capacity), front_space(0) {
+        if (count > capacity || (!data && capacity > 0)) {
+            throw std::invalid_argument("gap_buffer: invalid storage to adopt");
+        }
+    }
+    
+    GAP_BUFFER_CONSTEXPR gap_buffer(adopt_storage_t, storage_block block, const Allocator& alloc_ = Allocator())
+        : gap_buffer(adopt_storage, block.data, block.size, block.capacity, alloc_) {}
+    
     // Destructor
-    ~gap_buffer() {
+    GAP_BUFFER_CONSTEXPR ~gap_buffer() {
         clear();
         if (buffer) {
-            alloc.deallocate(buffer, buffer_size);
+            deallocate_storage();
         }
     }
     
     // Assignment operators
-    gap_buffer& operator=(const gap_buffer& other) {
+    GAP_BUFFER_CONSTEXPR gap_buffer& operator=(const gap_buffer& other) {
         if (this != &other) {
-            gap_buffer tmp(other);
-            swap(tmp);
+            clear();
+            if constexpr (std::allocator_traits<Allocator>::propagate_on_container_copy_assignment::value) {
+                if (alloc != other.alloc && buffer) {
+                    // Storage from our allocator cannot outlive it
+                    deallocate_storage();
+                    buffer = nullptr;
+                    gap_start = gap_end = buffer_size = front_space = 0;
+                }
+                alloc = other.alloc;
+            }
+            copy_from(other);
         }
         return *this;
     }
     
-    gap_buffer& operator=(gap_buffer&& other) noexcept {
+    GAP_BUFFER_CONSTEXPR gap_buffer& operator=(gap_buffer&& other) noexcept {
         if (this != &other) {
             clear();
             if (buffer) {
-                alloc.deallocate(buffer, buffer_size);
+                deallocate_storage();
             }
             
             alloc = std::move(other.alloc);
@@ -332,91 +784,98 @@ public:
             gap_start = other.gap_start;
             gap_end = other.gap_end;
             buffer_size = other.buffer_size;
+            front_space = other.front_space;
             
             other.buffer = nullptr;
             other.gap_start = 0;
             other.gap_end = 0;
             other.buffer_size = 0;
+            other.front_space = 0;
         }
         return *this;
     }
     
-    gap_buffer& operator=(std::initializer_list<T> ilist) {
+    GAP_BUFFER_CONSTEXPR gap_buffer& operator=(std::initializer_list<T> ilist) {
         assign(ilist);
         return *this;
     }
     
     // assign methods
-    void assign(size_type count, const T& value) {
+    GAP_BUFFER_CONSTEXPR void assign(size_type count, const T& value) {
         clear();
-        if (count > 0) {
-            if (buffer_size < count) {
-                grow(count);
-            }
-            
-            for (size_t i = 0; i < count; ++i) {
-                std::allocator_traits<Allocator>::construct(alloc, buffer + i, value);
-            }
-            
-            gap_start = count;
-            gap_end = buffer_size;
+        if (count > buffer_size) {
+            reset_storage(count);
         }
+        
+        fill_at_gap(count, value);
     }
     
     template <typename InputIt, typename = 
               std::enable_if_t<!std::is_integral<InputIt>::value>>
-    void assign(InputIt first, InputIt last) {
+    GAP_BUFFER_CONSTEXPR void assign(InputIt first, InputIt last) {
         clear();
-        insert(begin(), first, last);
+        
+        using category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value) {
+            size_t count = std::distance(first, last);
+            if (count > buffer_size) {
+                reset_storage(count);
+            }
+            construct_at_gap(first, count);
+        } else {
+            for (; first != last; ++first) {
+                push_back(*first);
+            }
+        }
     }
     
-    void assign(std::initializer_list<T> ilist) {
+    GAP_BUFFER_CONSTEXPR void assign(std::initializer_list<T> ilist) {
         assign(ilist.begin(), ilist.end());
     }
     
     // Get allocator
-    allocator_type get_allocator() const noexcept {
+    GAP_BUFFER_CONSTEXPR allocator_type get_allocator() const noexcept {
         return alloc;
     }
     
     // Element access
-    reference at(size_type pos) {
+    GAP_BUFFER_CONSTEXPR reference at(size_type pos) {
         if (pos >= size()) {
             throw std::out_of_range("gap_buffer::at");
         }
         return (*this)[pos];
     }
     
-    const_reference at(size_type pos) const {
+    GAP_BUFFER_CONSTEXPR const_reference at(size_type pos) const {
         if (pos >= size()) {
             throw std::out_of_range("gap_buffer::at");
         }
         return (*this)[pos];
     }
     
-    reference operator[](size_type pos) {
+    GAP_BUFFER_CONSTEXPR reference operator[](size_type pos) {
         return pos >= gap_start ? buffer[pos + (gap_end - gap_start)] : buffer[pos];
     }
     
-    const_reference operator[](size_type pos) const {
+    GAP_BUFFER_CONSTEXPR const_reference operator[](size_type pos) const {
         return pos >= gap_start ? buffer[pos + (gap_end - gap_start)] : buffer[pos];
     }
     
-    reference front() {
+    GAP_BUFFER_CONSTEXPR reference front() {
         if (empty()) {
             throw std::out_of_range("gap_buffer::front called on empty container");
         }
-        return buffer[0];
+        return (*this)[0];
     }
     
-    const_reference front() const {
+    GAP_BUFFER_CONSTEXPR const_reference front() const {
         if (empty()) {
             throw std::out_of_range("gap_buffer::front called on empty container");
         }
-        return buffer[0];
+        return (*this)[0];
     }
     
-    reference back() {
+    GAP_BUFFER_CONSTEXPR reference back() {
         if (empty()) {
             throw std::out_of_range("gap_buffer::back called on empty container");
         }
@@ -424,7 +883,7 @@ public:
         return (*this)[last_pos];
     }
     
-    const_reference back() const {
+    GAP_BUFFER_CONSTEXPR const_reference back() const {
         if (empty()) {
             throw std::out_of_range("gap_buffer::back called on empty container");
         }
@@ -432,122 +891,174 @@ public:
         return (*this)[last_pos];
     }
     
-    T* data() noexcept {
+    GAP_BUFFER_CONSTEXPR T* data() noexcept {
         if (empty()) return nullptr;
-        move_gap(size());  // Move gap to end
-        return buffer;
+        // Gap at whichever end is closer
+        return contiguous_view(0, size()).first;
     }
     
-    const T* data() const noexcept {
+    GAP_BUFFER_CONSTEXPR const T* data() const noexcept {
         if (empty()) return nullptr;
         // For const version, we cannot modify the buffer
         // Return nullptr to indicate non-contiguous data
-        if (gap_start != 0 && gap_end != buffer_size) {
-            return nullptr;
+        return contiguous_view(0, size()).first;
+    }
+    
+    // The contents as the two runs either side of the gap (either may be
+    // empty), without moving anything; std::views::join(segments()) walks
+    // the elements in order
+    GAP_BUFFER_CONSTEXPR std::array<segment, 2> segments() noexcept {
+        return {segment(buffer, gap_start), segment(buffer + gap_end, buffer_size - gap_end)};
+    }
+
+    GAP_BUFFER_CONSTEXPR std::array<const_segment, 2> segments() const noexcept {
+        return {const_segment(buffer, gap_start), const_segment(buffer + gap_end, buffer_size - gap_end)};
+    }
+
+    // Pointer range over the elements [pos, pos + len), clamped to size().
+    // A range on one side of the gap is returned in place; one that
+    // straddles the gap is made contiguous by moving the gap past whichever
+    // end of the range is nearer, so only the straddling part moves.
+    GAP_BUFFER_CONSTEXPR std::pair<T*, T*> contiguous_view(size_type pos, size_type len) {
+        if (pos > size()) {
+            throw std::out_of_range("gap_buffer::contiguous_view");
+        }
+        len = std::min(len, size() - pos);
+        
+        size_t last = pos + len;
+        if (pos < gap_start && last > gap_start) {
+            move_gap(gap_start - pos <= last - gap_start ? pos : last);
+        }
+        
+        T* first = buffer + (pos < gap_start ? pos : pos + (gap_end - gap_start));
+        return {first, first + len};
+    }
+    
+    // Longest run of elements starting at pos that is contiguous in storage
+    // (up to the gap or the end); empty at size()
+    GAP_BUFFER_CONSTEXPR std::pair<const T*, const T*> chunk_at(size_type pos) const {
+        if (pos > size()) {
+            throw std::out_of_range("gap_buffer::chunk_at");
         }
-        return buffer;
+        if (pos < gap_start) {
+            return {buffer + pos, buffer + gap_start};
+        }
+        const T* first = buffer + pos + (gap_end - gap_start);
+        return {first, buffer + buffer_size};
+    }
+    
+    // Const version cannot move the gap; a range that straddles it yields
+    // a pair of null pointers
+    GAP_BUFFER_CONSTEXPR std::pair<const T*, const T*> contiguous_view(size_type pos, size_type len) const {
+        if (pos > size()) {
+            throw std::out_of_range("gap_buffer::contiguous_view");
+        }
+        len = std::min(len, size() - pos);
+        
+        if (pos < gap_start && pos + len > gap_start) {
+            return {nullptr, nullptr};
+        }
+        
+        const T* first = buffer + (pos < gap_start ? pos : pos + (gap_end - gap_start));
+        return {first, first + len};
     }
     
     // Iterators
-    iterator begin() noexcept {
+    GAP_BUFFER_CONSTEXPR iterator begin() noexcept {
         return iterator(buffer, 0, gap_start, gap_end, buffer_size);
     }
     
-    const_iterator begin() const noexcept {
+    GAP_BUFFER_CONSTEXPR const_iterator begin() const noexcept {
         return const_iterator(buffer, 0, gap_start, gap_end, buffer_size);
     }
     
-    const_iterator cbegin() const noexcept {
+    GAP_BUFFER_CONSTEXPR const_iterator cbegin() const noexcept {
         return const_iterator(buffer, 0, gap_start, gap_end, buffer_size);
     }
     
-    iterator end() noexcept {
+    GAP_BUFFER_CONSTEXPR iterator end() noexcept {
         return iterator(buffer, size(), gap_start, gap_end, buffer_size);
     }
     
-    const_iterator end() const noexcept {
+    GAP_BUFFER_CONSTEXPR const_iterator end() const noexcept {
         return const_iterator(buffer, size(), gap_start, gap_end, buffer_size);
     }
     
-    const_iterator cend() const noexcept {
+    GAP_BUFFER_CONSTEXPR const_iterator cend() const noexcept {
         return const_iterator(buffer, size(), gap_start, gap_end, buffer_size);
     }
     
-    reverse_iterator rbegin() noexcept {
+    GAP_BUFFER_CONSTEXPR reverse_iterator rbegin() noexcept {
         return reverse_iterator(end());
     }
     
-    const_reverse_iterator rbegin() const noexcept {
+    GAP_BUFFER_CONSTEXPR const_reverse_iterator rbegin() const noexcept {
         return const_reverse_iterator(end());
     }
     
-    const_reverse_iterator crbegin() const noexcept {
+    GAP_BUFFER_CONSTEXPR const_reverse_iterator crbegin() const noexcept {
         return const_reverse_iterator(cend());
     }
     
-    reverse_iterator rend() noexcept {
+    GAP_BUFFER_CONSTEXPR reverse_iterator rend() noexcept {
         return reverse_iterator(begin());
     }
     
-    const_reverse_iterator rend() const noexcept {
+    GAP_BUFFER_CONSTEXPR const_reverse_iterator rend() const noexcept {
         return const_reverse_iterator(begin());
     }
     
-    const_reverse_iterator crend() const noexcept {
+    GAP_BUFFER_CONSTEXPR const_reverse_iterator crend() const noexcept {
         return const_reverse_iterator(cbegin());
     }
     
     // Capacity
-    [[nodiscard]] bool empty() const noexcept {
+    [[nodiscard]] GAP_BUFFER_CONSTEXPR bool empty() const noexcept {
         return size() == 0;
     }
     
-    size_type size() const noexcept {
+    GAP_BUFFER_CONSTEXPR size_type size() const noexcept {
         return buffer_size - (gap_end - gap_start);
     }
     
-    size_type max_size() const noexcept {
+    GAP_BUFFER_CONSTEXPR size_type max_size() const noexcept {
         return std::allocator_traits<Allocator>::max_size(alloc);
     }
     
-    void reserve(size_type new_cap) {
+    GAP_BUFFER_CONSTEXPR void reserve(size_type new_cap) {
         if (new_cap > capacity()) {
-            grow(new_cap + (gap_end - gap_start));
+            grow(new_cap);
         }
     }
     
-    size_type capacity() const noexcept {
-        return buffer_size - (gap_end - gap_start);
+    GAP_BUFFER_CONSTEXPR size_type capacity() const noexcept {
+        return buffer_size;
     }
     
-    void shrink_to_fit() {
-        if (size() < capacity()) {
+    GAP_BUFFER_CONSTEXPR void shrink_to_fit() {
+        if (size() < capacity() || front_space > 0) {
             gap_buffer tmp(*this);
             swap(tmp);
         }
     }
     
     // Modifiers
-    void clear() noexcept {
+    GAP_BUFFER_CONSTEXPR void clear() noexcept {
         if (buffer) {
-            for (size_t i = 0; i < gap_start; ++i) {
-                std::allocator_traits<Allocator>::destroy(alloc, buffer + i);
-            }
-            for (size_t i = gap_end; i < buffer_size; ++i) {
-                std::allocator_traits<Allocator>::destroy(alloc, buffer + i);
-            }
+            destroy_range(buffer, buffer + gap_start);
+            destroy_range(buffer + gap_end, buffer + buffer_size);
         }
+        // With nothing left to slide, the front space is free to take back
+        buffer -= front_space;
+        buffer_size += front_space;
+        front_space = 0;
         gap_start = 0;
         gap_end = buffer_size;
     }
     
-    iterator insert(const_iterator pos, const T& value) {
+    GAP_BUFFER_CONSTEXPR iterator insert(const_iterator pos, const T& value) {
         size_t position = pos.pos;
-        move_gap(position);
-        
-        if (gap_end == gap_start) {
-            grow();
-        }
+        open_gap(position, 1);
         
         std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, value);
         size_t old_gap_start = gap_start;
@@ -556,13 +1067,9 @@ public:
         return iterator(buffer, old_gap_start, gap_start, gap_end, buffer_size);
     }
     
-    iterator insert(const_iterator pos, T&& value) {
+    GAP_BUFFER_CONSTEXPR iterator insert(const_iterator pos, T&& value) {
         size_t position = pos.pos;
-        move_gap(position);
-        
-        if (gap_end == gap_start) {
-            grow();
-        }
+        open_gap(position, 1);
         
         std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, std::move(value));
         size_t old_gap_start = gap_start;
@@ -571,63 +1078,45 @@ public:
         return iterator(buffer, old_gap_start, gap_start, gap_end, buffer_size);
     }
     
-    iterator insert(const_iterator pos, size_type count, const T& value) {
+    GAP_BUFFER_CONSTEXPR iterator insert(const_iterator pos, size_type count, const T& value) {
         if (count == 0) {
             return iterator(buffer, pos.pos, gap_start, gap_end, buffer_size);
         }
         
         size_t position = pos.pos;
-        move_gap(position);
-        
-        if (gap_end - gap_start < count) {
-            grow(buffer_size + count - (gap_end - gap_start));
-        }
+        open_gap(position, count);
         
         size_t old_gap_start = gap_start;
-        for (size_t i = 0; i < count; ++i) {
-            std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, value);
-            ++gap_start;
-        }
+        fill_at_gap(count, value);
         
         return iterator(buffer, old_gap_start, gap_start, gap_end, buffer_size);
     }
     
     template <typename InputIt, typename = 
               std::enable_if_t<!std::is_integral<InputIt>::value>>
-    iterator insert(const_iterator pos, InputIt first, InputIt last) {
+    GAP_BUFFER_CONSTEXPR iterator insert(const_iterator pos, InputIt first, InputIt last) {
         size_t position = pos.pos;
-        move_gap(position);
-        
         size_t count = std::distance(first, last);
         if (count == 0) {
             return iterator(buffer, position, gap_start, gap_end, buffer_size);
         }
         
-        if (gap_end - gap_start < count) {
-            grow(buffer_size + count - (gap_end - gap_start));
-        }
+        open_gap(position, count);
         
         size_t old_gap_start = gap_start;
-        for (auto it = first; it != last; ++it) {
-            std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, *it);
-            ++gap_start;
-        }
+        construct_at_gap(first, count);
         
         return iterator(buffer, old_gap_start, gap_start, gap_end, buffer_size);
     }
     
-    iterator insert(const_iterator pos, std::initializer_list<T> ilist) {
+    GAP_BUFFER_CONSTEXPR iterator insert(const_iterator pos, std::initializer_list<T> ilist) {
         return insert(pos, ilist.begin(), ilist.end());
     }
     
     template <typename... Args>
-    iterator emplace(const_iterator pos, Args&&... args) {
+    GAP_BUFFER_CONSTEXPR iterator emplace(const_iterator pos, Args&&... args) {
         size_t position = pos.pos;
-        move_gap(position);
-        
-        if (gap_end == gap_start) {
-            grow();
-        }
+        open_gap(position, 1);
         
         std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, std::forward<Args>(args)...);
         size_t old_gap_start = gap_start;
@@ -636,57 +1125,69 @@ public:
         return iterator(buffer, old_gap_start, gap_start, gap_end, buffer_size);
     }
     
-    iterator erase(const_iterator pos) {
+    GAP_BUFFER_CONSTEXPR iterator erase(const_iterator pos) {
         return erase(pos, pos + 1);
     }
     
-    iterator erase(const_iterator first, const_iterator last) {
+    GAP_BUFFER_CONSTEXPR iterator erase(const_iterator first, const_iterator last) {
         if (first == last) {
             return iterator(buffer, first.pos, gap_start, gap_end, buffer_size);
         }
         
         size_t position = first.pos;
-        size_t count = last.pos - first.pos;
-        
-        move_gap(position);
+        size_t count = std::min(last.pos - first.pos, size() - position);
+        
+        // A range at the very front, before the gap, is dropped by advancing
+        // the start of the storage: nothing moves, and the slots are taken
+        // back by open_gap() later
+        size_t last_pos = position + count;
+        if (position == 0 && last_pos < gap_start) {
+            destroy_range(buffer, buffer + count);
+            buffer += count;
+            front_space += count;
+            gap_start -= count;
+            gap_end -= count;
+            buffer_size -= count;
+            return begin();
+        }
         
-        for (size_t i = 0; i < count && gap_end < buffer_size; ++i) {
-            std::allocator_traits<Allocator>::destroy(alloc, buffer + gap_end);
-            ++gap_end;
+        // Bring the gap up against the range from whichever side moves
+        // fewer elements; a range that already touches or contains the gap
+        // moves nothing
+        if (last_pos <= gap_start) {
+            move_gap(last_pos);
+        } else if (position > gap_start) {
+            move_gap(position);
         }
         
+        // Absorb the part before the gap from the left, the rest from the right
+        size_t before_gap = gap_start - position;
+        size_t after_gap = count - before_gap;
+        destroy_range(buffer + position, buffer + gap_start);
+        destroy_range(buffer + gap_end, buffer + gap_end + after_gap);
+        gap_start = position;
+        gap_end += after_gap;
+        
         return iterator(buffer, position, gap_start, gap_end, buffer_size);
     }
     
-    void push_back(const T& value) {
-        move_gap(size());
-        
-        if (gap_end == gap_start) {
-            grow();
-        }
+    GAP_BUFFER_CONSTEXPR void push_back(const T& value) {
+        open_gap(size(), 1);
         
         std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, value);
         ++gap_start;
     }
     
-    void push_back(T&& value) {
-        move_gap(size());
-        
-        if (gap_end == gap_start) {
-            grow();
-        }
+    GAP_BUFFER_CONSTEXPR void push_back(T&& value) {
+        open_gap(size(), 1);
         
         std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, std::move(value));
         ++gap_start;
     }
     
     template <typename... Args>
-    reference emplace_back(Args&&... args) {
-        move_gap(size());
-        
-        if (gap_end == gap_start) {
-            grow();
-        }
+    GAP_BUFFER_CONSTEXPR reference emplace_back(Args&&... args) {
+        open_gap(size(), 1);
         
         std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, std::forward<Args>(args)...);
         ++gap_start;
@@ -694,69 +1195,161 @@ public:
         return buffer[gap_start - 1];
     }
     
-    void pop_back() {
-        if (empty()) return;
-        
-        size_t last_pos = size() - 1;
-        if (last_pos < gap_start) {
-            // Element is before gap
+    GAP_BUFFER_CONSTEXPR void pop_back() {
+        if (gap_end == buffer_size) {
+            // Gap at the end: the last element sits right before it
+            if (gap_start == 0) return;
             --gap_start;
 	    std::allocator_traits<Allocator>::destroy(alloc, buffer + gap_start);
         } else {
-            // Element is after gap
-            size_t real_pos = last_pos + (gap_end - gap_start);
-	    std::allocator_traits<Allocator>::destroy(alloc, buffer + real_pos);
+            // Element is after gap; bring the gap up to it first
+            move_gap(size() - 1);
+	    std::allocator_traits<Allocator>::destroy(alloc, buffer + gap_end);
             ++gap_end;
         }
     }
     
-    void resize(size_type count) {
+    GAP_BUFFER_CONSTEXPR void resize(size_type count) {
         size_type current_size = size();
         if (count > current_size) {
             // Enlarge
-            reserve(count);
-            move_gap(current_size);
-            
-            for (size_t i = current_size; i < count; ++i) {
-                std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, T());
-                ++gap_start;
-            }
+            open_gap(current_size, count - current_size);
+            value_construct_at_gap(count - current_size);
         } else if (count < current_size) {
-            // Shrink
-            size_t to_remove = current_size - count;
-            
-            // Remove elements from the end
-            for (size_t i = 0; i < to_remove; ++i) {
-                pop_back();
-            }
+            // Shrink: the tail joins the gap in one step, which moves nothing
+            // unless the cut falls after the gap
+            erase(begin() + count, end());
         }
     }
     
-    void resize(size_type count, const value_type& value) {
+    GAP_BUFFER_CONSTEXPR void resize(size_type count, const value_type& value) {
         size_type current_size = size();
         if (count > current_size) {
             // Enlarge
-            reserve(count);
-            move_gap(current_size);
-            
-            for (size_t i = current_size; i < count; ++i) {
-                std::allocator_traits<Allocator>::construct(alloc, buffer + gap_start, value);
-                ++gap_start;
-            }
+            open_gap(current_size, count - current_size);
+            fill_at_gap(count - current_size, value);
         } else if (count < current_size) {
             // Shrink
             resize(count);
         }
     }
     
-    void swap(gap_buffer& other) noexcept {
+    // Hand the storage to the caller with the elements contiguous at the
+    // front, leaving the buffer empty. The caller destroys the elements and
+    // deallocates the block with get_allocator().
+    GAP_BUFFER_CONSTEXPR storage_block release() {
+        reclaim_front_space();
+        move_gap(size());
+        
+        storage_block block{buffer, gap_start, buffer_size};
+        buffer = nullptr;
+        gap_start = 0;
+        gap_end = 0;
+        buffer_size = 0;
+        return block;
+    }
+    
+    GAP_BUFFER_CONSTEXPR void swap(gap_buffer& other) noexcept {
         std::swap(buffer, other.buffer);
         std::swap(gap_start, other.gap_start);
         std::swap(gap_end, other.gap_end);
         std::swap(buffer_size, other.buffer_size);
+        std::swap(front_space, other.front_space);
         std::swap(alloc, other.alloc);
     }
     
+    // Direct writes into the gap for trivially copyable types: prepare_insert
+    // puts the gap at pos with room for at least count elements and returns
+    // the whole gap; writing n elements there and calling commit_insert(n)
+    // inserts them. Any other modification in between discards the writes.
+    GAP_BUFFER_CONSTEXPR std::pair<T*, T*> prepare_insert(size_type pos, size_type count) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "gap_buffer::prepare_insert requires a trivially copyable type");
+        if (pos > size()) {
+            throw std::out_of_range("gap_buffer::prepare_insert");
+        }
+        open_gap(pos, count);
+        return {buffer + gap_start, buffer + gap_end};
+    }
+    
+    GAP_BUFFER_CONSTEXPR void commit_insert(size_type count) {
+        if (count > gap_end - gap_start) {
+            throw std::out_of_range("gap_buffer::commit_insert");
+        }
+        gap_start += count;
+    }
+    
+    // Move count elements starting at src_pos out of src and insert them at
+    // pos. They are relocated straight from src's storage (at most two runs,
+    // one either side of its gap) into our gap, and src then absorbs the hole.
+    GAP_BUFFER_CONSTEXPR void splice(size_type pos, gap_buffer& src, size_type src_pos, size_type count) {
+        if (&src == this) {
+            throw std::invalid_argument("gap_buffer::splice source and destination must differ");
+        }
+        if (pos > size() || src_pos > src.size()) {
+            throw std::out_of_range("gap_buffer::splice");
+        }
+        count = std::min(count, src.size() - src_pos);
+        if (count == 0) return;
+        
+        open_gap(pos, count);
+        
+        size_t done = 0;
+        while (done < count) {
+            size_t i = src_pos + done;
+            size_t run = count - done;
+            if (i < src.gap_start) run = std::min(run, src.gap_start - i);
+            
+            T* from = src.buffer + (i < src.gap_start ? i : i + (src.gap_end - src.gap_start));
+            if constexpr (std::is_trivially_copyable<T>::value) {
+                construct_at_gap(static_cast<const T*>(from), run);
+            } else {
+                construct_at_gap(std::make_move_iterator(from), run);
+            }
+            done += run;
+        }
+        
+        src.erase(src.begin() + src_pos, src.begin() + src_pos + count);
+    }
+    
+    // Element-wise comparison, run by run rather than per element through
+    // iterators; memcmp is used where it gives the same answer
+    GAP_BUFFER_CONSTEXPR bool equals(const gap_buffer& other) const {
+        if (size() != other.size()) return false;
+        
+        return compare_runs(other, size(), [](const T* a, const T* b, size_t len) -> int {
+            if constexpr (bitwise_equality) {
+                if (!is_constant_evaluated()) {
+                    return std::memcmp(a, b, len * sizeof(T)) != 0;
+                }
+            }
+            return std::equal(a, a + len, b) ? 0 : 1;
+        }) == 0;
+    }
+    
+    // Lexicographical three-way comparison using operator< on elements
+    GAP_BUFFER_CONSTEXPR int compare(const gap_buffer& other) const {
+        size_t common = std::min(size(), other.size());
+        
+        int result = compare_runs(other, common, [](const T* a, const T* b, size_t len) -> int {
+            if constexpr (bytewise_ordering) {
+                if (!is_constant_evaluated()) {
+                    int r = std::memcmp(a, b, len);
+                    return r < 0 ? -1 : (r > 0 ? 1 : 0);
+                }
+            }
+            for (size_t i = 0; i < len; ++i) {
+                if (a[i] < b[i]) return -1;
+                if (b[i] < a[i]) return 1;
+            }
+            return 0;
+        });
+        
+        if (result != 0) return result;
+        if (size() < other.size()) return -1;
+        return size() > other.size() ? 1 : 0;
+    }
+    
     // Convert to string (for text_editor_buffer)
     std::string to_string() const {
         std::string result;
@@ -772,48 +1365,848 @@ public:
 
 // Non-member functions
 template <typename T, typename Alloc>
-bool operator==(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
-    if (lhs.size() != rhs.size()) return false;
-    return std::equal(lhs.begin(), lhs.end(), rhs.begin());
+GAP_BUFFER_CONSTEXPR bool operator==(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
+    return lhs.equals(rhs);
 }
 
 template <typename T, typename Alloc>
-bool operator!=(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
+GAP_BUFFER_CONSTEXPR bool operator!=(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
     return !(lhs == rhs);
 }
 
 template <typename T, typename Alloc>
-bool operator<(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
-    return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+GAP_BUFFER_CONSTEXPR bool operator<(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
+    return lhs.compare(rhs) < 0;
 }
 
 template <typename T, typename Alloc>
-bool operator>(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
+GAP_BUFFER_CONSTEXPR bool operator>(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
     return rhs < lhs;
 }
 
 template <typename T, typename Alloc>
-bool operator<=(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
+GAP_BUFFER_CONSTEXPR bool operator<=(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
     return !(rhs < lhs);
 }
 
 template <typename T, typename Alloc>
-bool operator>=(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
+GAP_BUFFER_CONSTEXPR bool operator>=(const gap_buffer<T, Alloc>& lhs, const gap_buffer<T, Alloc>& rhs) {
     return !(lhs < rhs);
 }
 
 template <typename T, typename Alloc>
-void swap(gap_buffer<T, Alloc>& lhs, gap_buffer<T, Alloc>& rhs) noexcept {
+GAP_BUFFER_CONSTEXPR void swap(gap_buffer<T, Alloc>& lhs, gap_buffer<T, Alloc>& rhs) noexcept {
     lhs.swap(rhs);
 }
 
 
+// Segmented parallel algorithms. The contents are cut into chunks of about
+// 1 MiB that never straddle the gap, so workers run plain pointer loops
+// instead of going through gap-aware iterators. Workers claim chunks from
+// a shared counter, so a slow chunk does not stall an even split.
+// threads == 0 uses std::thread::hardware_concurrency(); the caller's
+// thread always takes part. The callables must be safe to run concurrently.
+template <typename T>
+constexpr size_t parallel_chunk_elements() {
+    return std::max<size_t>(1, (size_t(1) << 20) / sizeof(T));
+}
+
+template <typename Buffer>
+size_t parallel_chunk_count(const Buffer& buf) {
+    const size_t per_chunk = parallel_chunk_elements<typename Buffer::value_type>();
+    auto segs = buf.segments();
+    return (segs[0].size() + per_chunk - 1) / per_chunk + (segs[1].size() + per_chunk - 1) / per_chunk;
+}
+
+// Run body(first, last, chunk_index, logical_offset) for every chunk of buf
+template <typename Buffer, typename Body>
+void parallel_for_chunks(Buffer& buf, unsigned threads, Body body) {
+    auto segs = buf.segments();
+    const size_t per_chunk = parallel_chunk_elements<typename Buffer::value_type>();
+    const size_t front_chunks = (segs[0].size() + per_chunk - 1) / per_chunk;
+    const size_t chunks = parallel_chunk_count(buf);
+    if (chunks == 0) return;
+    
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, chunks));
+    
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_lock;
+    
+    auto worker = [&]() {
+        try {
+            for (size_t k; (k = next.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+                bool back = k >= front_chunks;
+                auto& seg = segs[back];
+                size_t begin = (back ? k - front_chunks : k) * per_chunk;
+                size_t end = std::min(begin + per_chunk, static_cast<size_t>(seg.size()));
+                body(seg.data() + begin, seg.data() + end, k, (back ? segs[0].size() : 0) + begin);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_lock);
+            if (!error) error = std::current_exception();
+            next.store(chunks);
+        }
+    };
+    
+    std::vector<std::thread> pool;
+    try {
+        pool.reserve(threads - 1);
+        for (unsigned i = 1; i < threads; ++i) {
+            pool.emplace_back(worker);
+        }
+    } catch (...) {
+        next.store(chunks);
+        for (auto& t : pool) t.join();
+        throw;
+    }
+    
+    worker();
+    for (auto& t : pool) t.join();
+    
+    if (error) std::rethrow_exception(error);
+}
+
+template <typename Buffer, typename U>
+size_t parallel_count(const Buffer& buf, const U& value, unsigned threads = 0) {
+    std::atomic<size_t> total(0);
+    parallel_for_chunks(buf, threads, [&](auto first, auto last, size_t, size_t) {
+        total.fetch_add(static_cast<size_t>(std::count(first, last, value)), std::memory_order_relaxed);
+    });
+    return total.load();
+}
+
+// Iterator to the first match, or end(); chunks past an earlier match are skipped
+template <typename Buffer, typename U>
+auto parallel_find(Buffer& buf, const U& value, unsigned threads = 0) -> decltype(buf.begin()) {
+    std::atomic<size_t> found(buf.size());
+    parallel_for_chunks(buf, threads, [&](auto first, auto last, size_t, size_t offset) {
+        if (offset >= found.load(std::memory_order_relaxed)) return;
+        
+        auto it = std::find(first, last, value);
+        if (it == last) return;
+        
+        size_t pos = offset + static_cast<size_t>(it - first);
+        size_t current = found.load(std::memory_order_relaxed);
+        while (pos < current && !found.compare_exchange_weak(current, pos, std::memory_order_relaxed)) {}
+    });
+    return buf.begin() + static_cast<std::ptrdiff_t>(found.load());
+}
+
+// Replace every element x with op(x)
+template <typename T, typename Alloc, typename UnaryOp>
+void parallel_transform(gap_buffer<T, Alloc>& buf, UnaryOp op, unsigned threads = 0) {
+    parallel_for_chunks(buf, threads, [&](T* first, T* last, size_t, size_t) {
+        std::transform(first, last, first, op);
+    });
+}
+
+template <typename Buffer, typename Function>
+void parallel_for_each(Buffer& buf, Function fn, unsigned threads = 0) {
+    parallel_for_chunks(buf, threads, [&](auto first, auto last, size_t, size_t) {
+        std::for_each(first, last, fn);
+    });
+}
+
+// Chunks are reduced independently and then folded into init in order, so
+// op must be associative (as for std::reduce) but need not be commutative
+template <typename Buffer, typename R, typename BinaryOp = std::plus<>>
+R parallel_reduce(const Buffer& buf, R init, BinaryOp op = BinaryOp(), unsigned threads = 0) {
+    // Each chunk writes its own slot; a plain std::vector<R> would pack
+    // std::vector<bool> elements into shared words
+    struct slot {
+        R value;
+    };
+    std::vector<slot> partials(parallel_chunk_count(buf), slot{init});
+    parallel_for_chunks(buf, threads, [&](auto first, auto last, size_t chunk, size_t) {
+        partials[chunk].value = std::accumulate(first + 1, last, R(*first), op);
+    });
+    
+    for (auto& partial : partials) {
+        init = op(std::move(init), std::move(partial.value));
+    }
+    return init;
+}
+
+
+// Copy-on-write gap buffer - copies share one refcounted storage until one of
+// them is modified, so snapshots and undo checkpoints are O(1). The refcount
+// is std::shared_ptr's, so copies may be handed to other threads.
+template <typename T, typename Allocator = std::allocator<T>>
+class cow_gap_buffer {
+public:
+    using buffer_type = gap_buffer<T, Allocator>;
+    using value_type = T;
+    using allocator_type = Allocator;
+    using size_type = typename buffer_type::size_type;
+    using difference_type = typename buffer_type::difference_type;
+    using const_reference = typename buffer_type::const_reference;
+    using const_iterator = typename buffer_type::const_iterator;
+    using const_reverse_iterator = typename buffer_type::const_reverse_iterator;
+
+private:
+    std::shared_ptr<buffer_type> storage;
+    
+    static const buffer_type& empty_buffer() {
+        static const buffer_type empty;
+        return empty;
+    }
+    
+    // Take a private copy of the storage before the first write
+    buffer_type& detach() {
+        if (!storage) {
+            storage = std::make_shared<buffer_type>();
+        } else if (storage.use_count() != 1) {
+            storage = std::make_shared<buffer_type>(*storage);
+        } else {
+            // use_count() is a relaxed load; pair it with the release in
+            // another owner's reference drop so its last reads happen
+            // before our writes
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *storage;
+    }
+
+public:
+    // Constructors
+    cow_gap_buffer() = default;
+    
+    explicit cow_gap_buffer(buffer_type buffer)
+        : storage(std::make_shared<buffer_type>(std::move(buffer))) {}
+    
+    template <typename InputIt, typename = 
+              std::enable_if_t<!std::is_integral<InputIt>::value>>
+    cow_gap_buffer(InputIt first, InputIt last)
+        : storage(std::make_shared<buffer_type>(first, last)) {}
+    
+    cow_gap_buffer(std::initializer_list<T> init)
+        : storage(std::make_shared<buffer_type>(init)) {}
+    
+    // Read access never copies
+    const buffer_type& get() const noexcept {
+        return storage ? *storage : empty_buffer();
+    }
+    
+    bool is_shared() const noexcept {
+        return storage && storage.use_count() > 1;
+    }
+    
+    bool shares_storage_with(const cow_gap_buffer& other) const noexcept {
+        return storage && storage == other.storage;
+    }
+    
+    const_reference operator[](size_type pos) const { return get()[pos]; }
+    const_reference at(size_type pos) const { return get().at(pos); }
+    const_reference front() const { return get().front(); }
+    const_reference back() const { return get().back(); }
+    
+    const_iterator begin() const noexcept { return get().begin(); }
+    const_iterator end() const noexcept { return get().end(); }
+    const_iterator cbegin() const noexcept { return get().cbegin(); }
+    const_iterator cend() const noexcept { return get().cend(); }
+    const_reverse_iterator rbegin() const noexcept { return get().rbegin(); }
+    const_reverse_iterator rend() const noexcept { return get().rend(); }
+    
+    [[nodiscard]] bool empty() const noexcept { return get().empty(); }
+    size_type size() const noexcept { return get().size(); }
+    size_type capacity() const noexcept { return get().capacity(); }
+    
+    std::string to_string() const { return get().to_string(); }
+    
+    // Write access detaches from other copies first. Iterators obtained
+    // before a write may refer to the shared storage, so modifiers take
+    // positions rather than iterators.
+    buffer_type& edit() {
+        return detach();
+    }
+    
+    void set(size_type pos, const T& value) {
+        detach()[pos] = value;
+    }
+    
+    void insert(size_type pos, const T& value) {
+        buffer_type& buffer = detach();
+        buffer.insert(buffer.begin() + pos, value);
+    }
+    
+    template <typename InputIt, typename = 
+              std::enable_if_t<!std::is_integral<InputIt>::value>>
+    void insert(size_type pos, InputIt first, InputIt last) {
+        buffer_type& buffer = detach();
+        buffer.insert(buffer.begin() + pos, first, last);
+    }
+    
+    void erase(size_type pos, size_type count = 1) {
+        buffer_type& buffer = detach();
+        buffer.erase(buffer.begin() + pos, buffer.begin() + pos + count);
+    }
+    
+    void push_back(const T& value) { detach().push_back(value); }
+    void pop_back() { detach().pop_back(); }
+    void resize(size_type count) { detach().resize(count); }
+    void reserve(size_type new_cap) { detach().reserve(new_cap); }
+    void shrink_to_fit() { detach().shrink_to_fit(); }
+    
+    void clear() {
+        // Dropping our reference is cheaper than copying and clearing
+        if (is_shared()) {
+            storage.reset();
+        } else if (storage) {
+            storage->clear();
+        }
+    }
+    
+    void swap(cow_gap_buffer& other) noexcept {
+        storage.swap(other.storage);
+    }
+};
+
+template <typename T, typename Alloc>
+bool operator==(const cow_gap_buffer<T, Alloc>& lhs, const cow_gap_buffer<T, Alloc>& rhs) {
+    // Copies that still share storage are equal without looking at elements
+    return lhs.shares_storage_with(rhs) || lhs.get() == rhs.get();
+}
+
+template <typename T, typename Alloc>
+bool operator!=(const cow_gap_buffer<T, Alloc>& lhs, const cow_gap_buffer<T, Alloc>& rhs) {
+    return !(lhs == rhs);
+}
+
+template <typename T, typename Alloc>
+bool operator<(const cow_gap_buffer<T, Alloc>& lhs, const cow_gap_buffer<T, Alloc>& rhs) {
+    return !lhs.shares_storage_with(rhs) && lhs.get() < rhs.get();
+}
+
+template <typename T, typename Alloc>
+bool operator>(const cow_gap_buffer<T, Alloc>& lhs, const cow_gap_buffer<T, Alloc>& rhs) {
+    return rhs < lhs;
+}
+
+template <typename T, typename Alloc>
+bool operator<=(const cow_gap_buffer<T, Alloc>& lhs, const cow_gap_buffer<T, Alloc>& rhs) {
+    return !(rhs < lhs);
+}
+
+template <typename T, typename Alloc>
+bool operator>=(const cow_gap_buffer<T, Alloc>& lhs, const cow_gap_buffer<T, Alloc>& rhs) {
+    return !(lhs < rhs);
+}
+
+template <typename T, typename Alloc>
+void swap(cow_gap_buffer<T, Alloc>& lhs, cow_gap_buffer<T, Alloc>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+
+// Fenwick tree over a sequence of counts: prefix sums, point updates and
+// "which element holds the n-th unit" in O(log n). Replacing elements at the
+// back, or shrinking at the front, costs O(log n) per element; splicing
+// anywhere else rebuilds the tree in O(n).
+class prefix_sum_tree {
+private:
+    std::vector<size_t> values;
+    std::vector<size_t> tree;  // 1-based; tree[i] sums values (i - lowbit(i), i]
+    size_t head;               // Values dropped from the front, still in the tree
+    
+    static size_t lowbit(size_t i) {
+        return i & (~i + 1);
+    }
+    
+    void build() {
+        size_t n = values.size();
+        tree.assign(n + 1, 0);
+        for (size_t i = 1; i <= n; ++i) {
+            tree[i] += values[i - 1];
+            size_t parent = i + lowbit(i);
+            if (parent <= n) tree[parent] += tree[i];
+        }
+    }
+    
+    // Sum of the first count stored values, dropped ones included
+    size_t stored_prefix(size_t count) const {
+        size_t sum = 0;
+        for (size_t i = count; i > 0; i -= lowbit(i)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+    
+    void push_back(size_t value) {
+        values.push_back(value);
+        size_t i = values.size();
+        tree.push_back(value + stored_prefix(i - 1) - stored_prefix(i - lowbit(i)));
+    }
+    
+    void pop_back() {
+        values.pop_back();
+        tree.pop_back();
+    }
+    
+public:
+    prefix_sum_tree() : values(), tree(1, 0), head(0) {}
+    
+    explicit prefix_sum_tree(std::vector<size_t> counts) : values(std::move(counts)), tree(), head(0) {
+        build();
+    }
+    
+    size_t size() const noexcept {
+        return values.size() - head;
+    }
+    
+    size_t value(size_t index) const {
+        if (index >= size()) {
+            throw std::out_of_range("prefix_sum_tree::value");
+        }
+        return values[head + index];
+    }
+    
+    void set(size_t index, size_t value) {
+        if (index >= size()) {
+            throw std::out_of_range("prefix_sum_tree::set");
+        }
+        index += head;
+        // Unsigned wrap-around makes this a decrement when value shrinks
+        size_t delta = value - values[index];
+        values[index] = value;
+        for (size_t i = index + 1; i < tree.size(); i += lowbit(i)) {
+            tree[i] += delta;
+        }
+    }
+    
+    // Sum of the first count values
+    size_t prefix(size_t count) const {
+        return stored_prefix(head + std::min(count, size())) - stored_prefix(head);
+    }
+    
+    size_t total() const {
+        return prefix(size());
+    }
+    
+    // Index i with prefix(i) <= target < prefix(i + 1); size() if target >= total()
+    size_t find(size_t target) const {
+        target += stored_prefix(head);
+        size_t n = values.size();
+        size_t step = 1;
+        while (step * 2 <= n) step *= 2;
+        
+        size_t index = 0;
+        for (; step > 0; step /= 2) {
+            if (index + step <= n && tree[index + step] <= target) {
+                index += step;
+                target -= tree[index];
+            }
+        }
+        return std::max(index, head) - head;
+    }
+    
+    // Replace count values starting at index with replacement
+    void replace(size_t index, size_t count, const std::vector<size_t>& replacement) {
+        if (index > size() || count > size() - index) {
+            throw std::out_of_range("prefix_sum_tree::replace");
+        }
+        if (count == replacement.size()) {
+            for (size_t i = 0; i < count; ++i) {
+                set(index + i, replacement[i]);
+            }
+        } else if (index + count == size()) {
+            // Growing or shrinking at the back (appended lines)
+            for (size_t i = 0; i < count; ++i) pop_back();
+            for (size_t value : replacement) push_back(value);
+        } else if (index == 0 && count > replacement.size()) {
+            // Shrinking at the front (trimmed scrollback): the dropped values
+            // stay in the tree until they outnumber the live ones
+            head += count - replacement.size();
+            for (size_t i = 0; i < replacement.size(); ++i) {
+                set(i, replacement[i]);
+            }
+            if (head > values.size() / 2) {
+                values.erase(values.begin(), values.begin() + head);
+                head = 0;
+                build();
+            }
+        } else {
+            values.erase(values.begin() + head + index, values.begin() + head + index + count);
+            values.insert(values.begin() + head + index, replacement.begin(), replacement.end());
+            values.erase(values.begin(), values.begin() + head);
+            head = 0;
+            build();
+        }
+    }
+};
+
+
+// Sorted line start offsets. Dropping lines from the front is O(1)
+// amortized: dropped entries stay until they outnumber the live ones, and
+// stored offsets are rebased on access by the amount of text dropped.
+class line_start_index {
+private:
+    std::vector<size_t> starts;  // Offsets plus base, live from index head on
+    size_t head;
+    size_t base;
+    
+public:
+    line_start_index() : starts(), head(0), base(0) {}
+    
+    size_t size() const noexcept {
+        return starts.size() - head;
+    }
+    
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+    
+    size_t operator[](size_t line) const {
+        return starts[head + line] - base;
+    }
+    
+    void clear() noexcept {
+        starts.clear();
+        head = 0;
+        base = 0;
+    }
+    
+    void reserve(size_t count) {
+        starts.reserve(head + count);
+    }
+    
+    void assign(std::vector<size_t> offsets) {
+        starts = std::move(offsets);
+        head = 0;
+        base = 0;
+    }
+    
+    void push_back(size_t offset) {
+        starts.push_back(offset + base);
+    }
+    
+    // Index of the first line at or after from that starts after offset
+    size_t upper_bound(size_t offset, size_t from = 0) const {
+        auto it = std::upper_bound(starts.begin() + head + from, starts.end(), offset + base);
+        return static_cast<size_t>(it - starts.begin()) - head;
+    }
+    
+    // Add delta to the starts of lines from on; wraps around to subtract
+    void shift(size_t from, size_t delta) {
+        for (auto it = starts.begin() + head + from; it != starts.end(); ++it) {
+            *it += delta;
+        }
+    }
+    
+    void insert(size_t line, const std::vector<size_t>& offsets) {
+        auto it = starts.insert(starts.begin() + head + line, offsets.begin(), offsets.end());
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            it[i] += base;
+        }
+    }
+    
+    void erase(size_t first, size_t last) {
+        starts.erase(starts.begin() + head + first, starts.begin() + head + last);
+    }
+    
+    // The first count characters are gone, and with them the first lines
+    // line starts; whatever line count fell in the middle of starts at 0
+    void drop_front(size_t lines, size_t count) {
+        head += lines;
+        base += count;
+        starts[head] = base;
+        if (head > starts.size() / 2) {
+            starts.erase(starts.begin(), starts.begin() + head);
+            head = 0;
+        }
+    }
+};
+
+
+// Append-only journal of text edits for crash recovery. Every record carries
+// a sequence number and a checksum, so a torn tail left by a crash is
+// detected and ignored. Records are buffered and written with one fsync per
+// batch: once batch_bytes are pending, when the oldest pending record is
+// older than the sync interval (checked as records arrive), or on sync().
+// Attach it with text_editor_buffer::set_journal() and replay it with
+// text_editor_buffer::recover_from_journal().
+class edit_journal {
+public:
+    enum class record_kind : uint32_t {
+        insert = 1,
+        erase = 2
+    };
+    
+private:
+    // The journal starts with a stamp of the saved file it applies to
+    struct file_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t base_exists;
+        uint64_t base_size;
+        int64_t base_mtime;
+        uint64_t first_sequence;
+    };
+    
+    // Followed, for inserts, by length bytes of text
+    struct record_header {
+        uint32_t kind;
+        uint32_t checksum;
+        uint64_t sequence;
+        uint64_t position;
+        uint64_t length;
+    };
+    
+    static constexpr char journal_magic[8] = {'G', 'B', 'J', 'O', 'U', 'R', 'N', '\0'};
+    static constexpr uint32_t journal_version = 1;
+    
+    std::FILE* file;
+    std::vector<unsigned char> pending;
+    uint64_t sequence;
+    size_t batch_bytes;
+    std::chrono::milliseconds sync_interval;
+    std::chrono::steady_clock::time_point oldest_pending;
+    
+    // FNV-1a over the record header (checksum field zeroed) and its text
+    static uint32_t record_checksum(record_header header, std::string_view text) {
+        header.checksum = 0;
+        uint32_t hash = 2166136261u;
+        auto mix = [&](const unsigned char* data, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                hash = (hash ^ data[i]) * 16777619u;
+            }
+        };
+        mix(reinterpret_cast<const unsigned char*>(&header), sizeof(header));
+        mix(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+        return hash;
+    }
+    
+    static void stamp(const std::string& base_filename, file_header& header) {
+        std::error_code error;
+        auto length = std::filesystem::file_size(base_filename, error);
+        auto time = std::filesystem::last_write_time(base_filename, error);
+        header.base_exists = error ? 0 : 1;
+        header.base_size = error ? 0 : static_cast<uint64_t>(length);
+        header.base_mtime = error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+    }
+    
+    bool flush_to_disk() {
+        if (std::fflush(file) != 0) return false;
+#if defined(__unix__) || defined(__APPLE__)
+        return ::fsync(::fileno(file)) == 0;
+#else
+        return true;
+#endif
+    }
+    
+    void append(record_kind kind, size_t position, size_t length, std::string_view text) {
+        if (!file) return;
+        
+        record_header header{static_cast<uint32_t>(kind), 0, sequence++, position, length};
+        header.checksum = record_checksum(header, text);
+        
+        auto now = std::chrono::steady_clock::now();
+        if (pending.empty()) oldest_pending = now;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&header);
+        pending.insert(pending.end(), bytes, bytes + sizeof(header));
+        pending.insert(pending.end(), text.begin(), text.end());
+        
+        if (pending.size() >= batch_bytes || now - oldest_pending >= sync_interval) {
+            sync();
+        }
+    }
+    
+public:
+    edit_journal() : file(nullptr), pending(), sequence(0), batch_bytes(size_t(1) << 20),
+          sync_interval(100), oldest_pending() {}
+    
+    ~edit_journal() {
+        close();
+    }
+    
+    edit_journal(const edit_journal&) = delete;
+    edit_journal& operator=(const edit_journal&) = delete;
+    
+    // Start an empty journal over base_filename as it is on disk now (it
+    // may not exist yet). Call again after every save so the journal only
+    // holds edits the file lacks; sequence numbers carry on.
+    bool open(const std::string& journal_filename, const std::string& base_filename) {
+        close();
+        
+        file_header header{};
+        std::memcpy(header.magic, journal_magic, sizeof(header.magic));
+        header.version = journal_version;
+        stamp(base_filename, header);
+        header.first_sequence = sequence;
+        
+        file = std::fopen(journal_filename.c_str(), "wb");
+        if (!file) return false;
+        std::setvbuf(file, nullptr, _IONBF, 0);  // Batching happens in pending
+        
+        if (std::fwrite(&header, sizeof(header), 1, file) != 1 || !flush_to_disk()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+    
+    void close() {
+        if (!file) return;
+        
+        sync();
+        std::fclose(file);
+        file = nullptr;
+        pending.clear();
+    }
+    
+    bool is_open() const noexcept {
+        return file != nullptr;
+    }
+    
+    // Bound how much a crash can lose; an interval of zero syncs every record
+    void set_sync_policy(size_t bytes, std::chrono::milliseconds interval) {
+        batch_bytes = bytes;
+        sync_interval = interval;
+    }
+    
+    // Sequence number of the next record
+    uint64_t get_sequence() const noexcept {
+        return sequence;
+    }
+    
+    void record_insert(size_t position, std::string_view text) {
+        append(record_kind::insert, position, text.size(), text);
+    }
+    
+    void record_erase(size_t position, size_t count) {
+        append(record_kind::erase, position, count, std::string_view());
+    }
+    
+    // Write pending records and fsync; also worth calling when the editor
+    // goes idle, since the interval is only checked as records arrive
+    bool sync() {
+        if (!file) return false;
+        if (pending.empty()) return true;
+        
+        size_t expected = pending.size();
+        size_t written = std::fwrite(pending.data(), 1, expected, file);
+        pending.clear();
+        return written == expected && flush_to_disk();
+    }
+    
+    // Check that base_filename is still the file the journal was started
+    // over, call begin(base_exists), then apply(kind, position, length,
+    // text) for each intact record in sequence order. Replay ends quietly at
+    // the first torn, corrupt or out-of-order record, or when apply returns
+    // false.
+    template <typename Begin, typename Apply>
+    static bool replay(const std::string& journal_filename, const std::string& base_filename,
+                       Begin begin, Apply apply) {
+        std::ifstream in(journal_filename, std::ios::binary | std::ios::ate);
+        if (!in.is_open()) return false;
+        std::streamsize length = in.tellg();
+        if (length < static_cast<std::streamsize>(sizeof(file_header))) return false;
+        
+        std::vector<unsigned char> bytes(static_cast<size_t>(length));
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char*>(bytes.data()), length)) return false;
+        
+        file_header header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        file_header current{};
+        stamp(base_filename, current);
+        if (std::memcmp(header.magic, journal_magic, sizeof(header.magic)) != 0 ||
+            header.version != journal_version || header.base_exists != current.base_exists ||
+            header.base_size != current.base_size || header.base_mtime != current.base_mtime) return false;
+        
+        if (!begin(header.base_exists != 0)) return false;
+        
+        size_t offset = sizeof(header);
+        uint64_t expected = header.first_sequence;
+        while (bytes.size() - offset >= sizeof(record_header)) {
+            record_header record;
+            std::memcpy(&record, bytes.data() + offset, sizeof(record));
+            offset += sizeof(record);
+            
+            auto kind = static_cast<record_kind>(record.kind);
+            if (kind != record_kind::insert && kind != record_kind::erase) break;
+            size_t text_length = kind == record_kind::insert ? static_cast<size_t>(record.length) : 0;
+            if (record.length > bytes.size() - offset && kind == record_kind::insert) break;
+            
+            std::string_view text(reinterpret_cast<const char*>(bytes.data() + offset), text_length);
+            if (record.sequence != expected || record_checksum(record, text) != record.checksum) break;
+            if (!apply(kind, static_cast<size_t>(record.position), static_cast<size_t>(record.length), text)) break;
+            
+            offset += text_length;
+            ++expected;
+        }
+        return true;
+    }
+};
+
+
 // Text Editor Buffer class - specialization for char with cursor and line/column tracking
 class text_editor_buffer : public gap_buffer<char> {
+public:
+    // Row/column of a byte offset; columns count bytes
+    struct text_point {
+        size_t row;
+        size_t column;
+    };
+    
+    // One edit in the shape incremental parsers (e.g. tree-sitter's
+    // TSInputEdit) expect: the replaced range [start, old_end) now spans
+    // [start, new_end)
+    struct edit_description {
+        size_t start_byte;
+        size_t old_end_byte;
+        size_t new_end_byte;
+        text_point start_point;
+        text_point old_end_point;
+        text_point new_end_point;
+    };
+    
+    using edit_callback = std::function<void(const edit_description&)>;
+    
+    // Lines [first_line, last_line] of a fold; first_line stays visible
+    struct fold_range {
+        size_t first_line;
+        size_t last_line;
+    };
+    
+    // Half-open range of lines [first, last); last == to_end reaches past
+    // the end of the document (line numbers after it shifted)
+    struct line_range {
+        size_t first;
+        size_t last;
+    };
+    static constexpr size_t to_end = static_cast<size_t>(-1);
+    
 private:
     size_t cursor_pos;
-    mutable std::vector<size_t> line_starts;
+    mutable line_start_index line_starts;
     mutable bool line_cache_valid;
+    edit_callback on_edit;
+    
+    // Soft-wrap index: visual rows per line, valid only while the line
+    // cache is
+    size_t wrap_width;
+    mutable prefix_sum_tree visual_rows;
+    mutable bool wrap_index_valid;
+    
+    // Folds as byte offsets [start, end) that move with edits: start is the
+    // beginning of the header line, end the end of the last hidden line.
+    // visible_lines holds 1 per shown line and 0 per hidden one.
+    struct fold_marker {
+        size_t start;
+        size_t end;
+    };
+    std::vector<fold_marker> folds;
+    mutable prefix_sum_tree visible_lines;
+    mutable bool fold_index_valid;
+    
+    // Lines changed since the last take_dirty_lines(), sorted and disjoint
+    std::vector<line_range> dirty_lines;
+    
+    size_t max_lines;  // Cap for appended text, 0 = unlimited
+    edit_journal* journal;  // Not owned; nullptr when edits aren't journaled
     
     // Line cache management with better efficiency
     void update_line_cache() const {
@@ -834,6 +2227,709 @@ private:
     
     void invalidate_line_cache() {
         line_cache_valid = false;
+        wrap_index_valid = false;
+        fold_index_valid = false;
+        mark_dirty(0, to_end);
+    }
+    
+    void mark_dirty(size_t first, size_t last) {
+        // Skip ranges entirely before, absorb the ones that touch
+        auto it = std::lower_bound(dirty_lines.begin(), dirty_lines.end(), first,
+                                   [](const line_range& range, size_t line) { return range.last < line; });
+        auto end = it;
+        while (end != dirty_lines.end() && end->first <= last) {
+            first = std::min(first, end->first);
+            last = std::max(last, end->last);
+            ++end;
+        }
+        it = dirty_lines.erase(it, end);
+        dirty_lines.insert(it, line_range{first, last});
+    }
+    
+    // Lines [line, line + old_lines) became [line, line + new_lines); when
+    // the count changed, everything below moved too
+    void lines_replaced(size_t line, size_t old_lines, size_t new_lines) {
+        mark_dirty(line, old_lines == new_lines ? line + new_lines : to_end);
+        wrap_index_replace(line, old_lines, new_lines);
+        fold_index_replace(line, old_lines, new_lines);
+    }
+    
+    // Keep fold markers and a valid line cache in step with an edit instead
+    // of rescanning: only the new text is scanned and later line starts are
+    // shifted
+    void text_inserted(size_t pos, std::string_view text) {
+        for (auto& fold : folds) {
+            if (fold.start >= pos) fold.start += text.size();
+            if (fold.end >= pos) fold.end += text.size();
+        }
+        
+        if (!line_cache_valid) {
+            mark_dirty(0, to_end);
+            return;
+        }
+        
+        size_t next = line_starts.upper_bound(pos);
+        line_starts.shift(next, text.size());
+        
+        std::vector<size_t> added;
+        for (size_t i = text.find('\n'); i != std::string_view::npos; i = text.find('\n', i + 1)) {
+            added.push_back(pos + i + 1);
+        }
+        size_t line = next - 1;
+        line_starts.insert(next, added);
+        
+        lines_replaced(line, 1, added.size() + 1);
+    }
+    
+    void text_erased(size_t pos, size_t count) {
+        for (auto& fold : folds) {
+            fold.start = fold.start >= pos + count ? fold.start - count : std::min(fold.start, pos);
+            fold.end = fold.end >= pos + count ? fold.end - count : std::min(fold.end, pos);
+        }
+        // A fold the deletion touched goes away once it no longer spans a
+        // line break; the scan stops at the end of its header line
+        folds.erase(std::remove_if(folds.begin(), folds.end(), [&](const fold_marker& fold) {
+            return fold.start <= pos && fold.end >= pos && !contains_newline(fold.start, fold.end);
+        }), folds.end());
+        
+        if (!line_cache_valid) {
+            mark_dirty(0, to_end);
+            return;
+        }
+        
+        size_t first = line_starts.upper_bound(pos);
+        size_t last = line_starts.upper_bound(pos + count, first);
+        size_t line = first - 1;
+        size_t removed = last - first;
+        if (pos == 0) {
+            // Trimming the front (scrollback) rebases lazily
+            line_starts.drop_front(removed, count);
+        } else {
+            line_starts.shift(last, 0 - count);
+            line_starts.erase(first, last);
+        }
+        
+        lines_replaced(line, removed + 1, 1);
+    }
+    
+    // Line i spans [line_begin(i), line_end(i)), newline excluded
+    size_t line_begin(size_t line) const {
+        return line_starts[line];
+    }
+    
+    size_t line_end(size_t line) const {
+        return line + 1 < line_starts.size() ? line_starts[line + 1] - 1 : size();
+    }
+    
+    // Dropping the oldest lines moves nothing: the storage start advances
+    // and the line index rebases lazily
+    void trim_to_max_lines() {
+        if (max_lines == 0) return;
+        
+        update_line_cache();
+        if (line_starts.size() <= max_lines) return;
+        
+        delete_text(0, line_starts[line_starts.size() - max_lines]);
+    }
+    
+    // Re-create folds by line number after the text was replaced wholesale
+    void restore_folds(const std::vector<fold_range>& ranges) {
+        folds.clear();
+        for (const auto& range : ranges) {
+            add_fold(range.first_line, range.last_line);
+        }
+    }
+    
+    bool contains_newline(size_t from, size_t to) const {
+        while (from < to) {
+            auto run = chunk_at(from);
+            size_t len = std::min(static_cast<size_t>(run.second - run.first), to - from);
+            if (std::memchr(run.first, '\n', len)) return true;
+            from += len;
+        }
+        return false;
+    }
+    
+    // Wrapping counts UTF-8 code points, not bytes
+    size_t count_code_points(size_t from, size_t to) const {
+        size_t count = 0;
+        while (from < to) {
+            auto run = chunk_at(from);
+            size_t len = std::min(static_cast<size_t>(run.second - run.first), to - from);
+            for (size_t i = 0; i < len; ++i) {
+                count += !is_utf8_continuation(static_cast<unsigned char>(run.first[i]));
+            }
+            from += len;
+        }
+        return count;
+    }
+    
+    // Position of the n-th code point at or after pos, stopping at limit
+    size_t advance_code_points(size_t pos, size_t n, size_t limit) const {
+        for (; pos < limit; ++pos) {
+            if (!is_utf8_continuation(static_cast<unsigned char>((*this)[pos]))) {
+                if (n == 0) break;
+                --n;
+            }
+        }
+        return pos;
+    }
+    
+    size_t line_visual_rows(size_t line) const {
+        size_t length = count_code_points(line_begin(line), line_end(line));
+        return std::max<size_t>(1, (length + wrap_width - 1) / wrap_width);
+    }
+    
+    // Re-measure lines [line, line + new_lines), which replaced old_lines
+    // lines of the previous text
+    void wrap_index_replace(size_t line, size_t old_lines, size_t new_lines) {
+        if (!wrap_index_valid) return;
+        
+        std::vector<size_t> rows(new_lines);
+        for (size_t i = 0; i < new_lines; ++i) {
+            rows[i] = line_visual_rows(line + i);
+        }
+        visual_rows.replace(line, old_lines, rows);
+    }
+    
+    // Measure every line, spread across threads for large documents
+    void update_wrap_index() const {
+        update_line_cache();
+        if (wrap_index_valid || wrap_width == 0) return;
+        
+        size_t lines = line_starts.size();
+        std::vector<size_t> rows(lines);
+        auto measure = [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                rows[i] = line_visual_rows(i);
+            }
+        };
+        
+        unsigned threads = lines >= 65536 ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+        size_t per_thread = (lines + threads - 1) / threads;
+        std::vector<std::thread> workers;
+        for (size_t first = per_thread; first < lines; first += per_thread) {
+            size_t last = std::min(first + per_thread, lines);
+            try {
+                workers.emplace_back(measure, first, last);
+            } catch (...) {
+                measure(first, last);
+            }
+        }
+        measure(0, std::min(per_thread, lines));
+        for (auto& worker : workers) worker.join();
+        
+        visual_rows = prefix_sum_tree(std::move(rows));
+        wrap_index_valid = true;
+    }
+    
+    size_t line_of(size_t pos) const {
+        return line_starts.upper_bound(pos) - 1;
+    }
+    
+    bool line_hidden(size_t line) const {
+        for (const auto& fold : folds) {
+            if (line > line_of(fold.start) && line <= line_of(fold.end)) return true;
+        }
+        return false;
+    }
+    
+    void fold_index_replace(size_t line, size_t old_lines, size_t new_lines) {
+        if (!fold_index_valid) return;
+        
+        std::vector<size_t> shown(new_lines);
+        for (size_t i = 0; i < new_lines; ++i) {
+            shown[i] = line_hidden(line + i) ? 0 : 1;
+        }
+        visible_lines.replace(line, old_lines, shown);
+    }
+    
+    // Mark the lines each fold hides with a difference array, then build
+    // the tree in one pass
+    void update_fold_index() const {
+        update_line_cache();
+        if (fold_index_valid) return;
+        
+        size_t lines = line_starts.size();
+        std::vector<std::ptrdiff_t> depth(lines + 1, 0);
+        for (const auto& fold : folds) {
+            size_t first = line_of(fold.start) + 1;
+            size_t last = line_of(fold.end);
+            if (first <= last) {
+                ++depth[first];
+                --depth[last + 1];
+            }
+        }
+        
+        std::vector<size_t> shown(lines);
+        std::ptrdiff_t covering = 0;
+        for (size_t i = 0; i < lines; ++i) {
+            covering += depth[i];
+            shown[i] = covering > 0 ? 0 : 1;
+        }
+        
+        visible_lines = prefix_sum_tree(std::move(shown));
+        fold_index_valid = true;
+    }
+    
+    text_point point_at(size_t pos) const {
+        update_line_cache();
+        
+        size_t line = line_starts.upper_bound(pos) - 1;
+        return text_point{line, pos - line_starts[line]};
+    }
+    
+    // Log the edit as an erase of [start, old_end) followed by the text now
+    // at [start, new_end)
+    void journal_edit(size_t start, size_t old_end, size_t new_end) const {
+        if (old_end > start) {
+            journal->record_erase(start, old_end - start);
+        }
+        if (new_end > start) {
+            auto run = chunk_at(start);
+            if (static_cast<size_t>(run.second - run.first) >= new_end - start) {
+                journal->record_insert(start, std::string_view(run.first, new_end - start));
+            } else {
+                journal->record_insert(start, get_selection(start, new_end));
+            }
+        }
+    }
+    
+    void notify_edit(size_t start, size_t old_end, size_t new_end,
+                     text_point start_point, text_point old_end_point) const {
+        if (journal) journal_edit(start, old_end, new_end);
+        if (!on_edit) return;
+        
+        on_edit(edit_description{start, old_end, new_end,
+                                 start_point, old_end_point, point_at(new_end)});
+    }
+    
+    // Line index sidecar layout: this header, then line_count offsets of
+    // entry_size bytes each (4 below 4 GB, 8 otherwise) in native byte order
+    struct line_index_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entry_size;
+        uint64_t file_size;
+        int64_t mtime;
+        uint64_t sample_hash;
+        uint64_t line_count;
+    };
+    
+    static constexpr char line_index_magic[8] = {'G', 'B', 'L', 'I', 'N', 'E', 'S', '\0'};
+    static constexpr uint32_t line_index_version = 1;
+    
+    // FNV-1a over 64 evenly spaced 4 KB samples (the whole text when it is
+    // smaller), enough to tell a different file of the same size and mtime
+    uint64_t sample_hash() const {
+        const size_t block = 4096;
+        const size_t samples = 64;
+        uint64_t hash = 14695981039346656037ull;
+        
+        auto mix = [&](size_t from, size_t to) {
+            while (from < to) {
+                auto run = chunk_at(from);
+                size_t len = std::min(static_cast<size_t>(run.second - run.first), to - from);
+                for (size_t i = 0; i < len; ++i) {
+                    hash = (hash ^ static_cast<unsigned char>(run.first[i])) * 1099511628211ull;
+                }
+                from += len;
+            }
+        };
+        
+        if (size() <= block * samples) {
+            mix(0, size());
+        } else {
+            size_t stride = (size() - block) / (samples - 1);
+            for (size_t i = 0; i < samples; ++i) {
+                mix(i * stride, i * stride + block);
+            }
+        }
+        return hash;
+    }
+    
+    // Size and modification time of the file on disk, which must match the
+    // text in the buffer
+    bool file_identity(const std::string& filename, uint64_t& file_size, int64_t& mtime) const {
+        std::error_code error;
+        auto length = std::filesystem::file_size(filename, error);
+        if (error || length != size()) return false;
+        auto time = std::filesystem::last_write_time(filename, error);
+        if (error) return false;
+        
+        file_size = static_cast<uint64_t>(length);
+        mtime = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+    
+    // Decode count line starts of entry_size bytes each for a text of
+    // text_size bytes; they must start at 0 and strictly increase
+    static bool decode_line_starts(const unsigned char* entries, size_t bytes, uint64_t count,
+                                   uint32_t entry_size, size_t text_size, std::vector<size_t>& starts) {
+        if (count == 0 || count > text_size + 1 || bytes / entry_size < count) return false;
+        
+        starts.resize(static_cast<size_t>(count));
+        auto decode = [&](auto entry) {
+            bool ordered = true;
+            size_t previous = 0;
+            for (size_t i = 0; i < starts.size(); ++i) {
+                std::memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+                starts[i] = static_cast<size_t>(entry);
+                ordered &= i == 0 ? starts[i] == 0 : starts[i] > previous;
+                previous = starts[i];
+            }
+            return ordered && previous <= text_size;
+        };
+        return entry_size == 4 ? decode(uint32_t()) : decode(uint64_t());
+    }
+    
+    // Pass the line starts to sink(data, bytes) in blocks, entry_size bytes each
+    template <typename Sink>
+    void encode_line_starts(uint32_t entry_size, Sink sink) const {
+        std::vector<unsigned char> block;
+        block.reserve(size_t(1) << 16);
+        for (size_t i = 0; i < line_starts.size(); ++i) {
+            uint64_t offset = line_starts[i];
+            unsigned char bytes[8];
+            if (entry_size == 4) {
+                uint32_t narrow = static_cast<uint32_t>(offset);
+                std::memcpy(bytes, &narrow, 4);
+            } else {
+                std::memcpy(bytes, &offset, 8);
+            }
+            block.insert(block.end(), bytes, bytes + entry_size);
+            if (block.size() >= (size_t(1) << 16)) {
+                sink(block.data(), block.size());
+                block.clear();
+            }
+        }
+        sink(block.data(), block.size());
+    }
+    
+    void install_line_starts(std::vector<size_t> starts) {
+        line_starts.assign(std::move(starts));
+        line_cache_valid = true;
+        wrap_index_valid = false;
+        fold_index_valid = false;
+        mark_dirty(0, to_end);
+    }
+    
+    // Call fn(bytes, length) on the contents of filename: mapped on POSIX
+    // systems, read into memory elsewhere
+    template <typename Fn>
+    static bool with_file_bytes(const std::string& filename, Fn fn) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        size_t length = static_cast<size_t>(info.st_size);
+#ifdef MAP_POPULATE
+        void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+#else
+        void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+#endif
+        ::close(fd);
+        if (mapping == MAP_FAILED) return false;
+        
+        bool result = fn(static_cast<const unsigned char*>(mapping), length);
+        ::munmap(mapping, length);
+        return result;
+#else
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return false;
+        std::streamsize length = file.tellg();
+        if (length <= 0) return false;
+        
+        std::vector<unsigned char> bytes(static_cast<size_t>(length));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(bytes.data()), length)) return false;
+        return fn(bytes.data(), bytes.size());
+#endif
+    }
+    
+    // Session files: this header, then the text (the run before the gap,
+    // then the run after it), the line starts and the folds as pairs of
+    // uint64_t offsets. Sections are padded to 8 bytes so each is aligned
+    // in a mapping of the file. The checksum covers the whole file, taken
+    // with the checksum field zeroed.
+    struct session_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entry_size;  // Bytes per line start, as in the sidecar
+        uint64_t text_size;
+        uint64_t gap_position;
+        uint64_t cursor;
+        uint64_t wrap_width;
+        uint64_t max_lines;
+        uint64_t line_count;
+        uint64_t fold_count;
+        uint64_t checksum;
+    };
+    
+    static constexpr char session_magic[8] = {'G', 'B', 'S', 'E', 'S', 'S', 'N', '\0'};
+    static constexpr uint32_t session_version = 1;
+    
+    // FNV-1a over 8-byte words in four interleaved lanes (so the multiplies
+    // overlap), fed in pieces of any size
+    class word_checksum {
+    private:
+        uint64_t lanes[4];
+        unsigned char pending[32];
+        size_t pending_size;
+        
+        static uint64_t mix(uint64_t hash, uint64_t word) {
+            hash = (hash ^ word) * 1099511628211ull;
+            return hash ^ (hash >> 32);
+        }
+        
+        void mix_block(const unsigned char* data) {
+            for (size_t lane = 0; lane < 4; ++lane) {
+                uint64_t word;
+                std::memcpy(&word, data + lane * 8, 8);
+                lanes[lane] = mix(lanes[lane], word);
+            }
+        }
+        
+    public:
+        word_checksum() : lanes(), pending(), pending_size(0) {
+            for (size_t lane = 0; lane < 4; ++lane) {
+                lanes[lane] = 14695981039346656037ull + lane;
+            }
+        }
+        
+        void update(const unsigned char* data, size_t count) {
+            if (count == 0) return;  // data may be null (empty runs)
+            if (pending_size > 0) {
+                size_t take = std::min(count, sizeof(pending) - pending_size);
+                std::memcpy(pending + pending_size, data, take);
+                pending_size += take;
+                data += take;
+                count -= take;
+                if (pending_size < sizeof(pending)) return;
+                mix_block(pending);
+                pending_size = 0;
+            }
+            for (; count >= sizeof(pending); data += sizeof(pending), count -= sizeof(pending)) {
+                mix_block(data);
+            }
+            if (count > 0) std::memcpy(pending, data, count);
+            pending_size = count;
+        }
+        
+        uint64_t finish() {
+            if (pending_size > 0) {
+                std::memset(pending + pending_size, 0, sizeof(pending) - pending_size);
+                mix_block(pending);
+                pending_size = 0;
+            }
+            uint64_t hash = 14695981039346656037ull;
+            for (uint64_t lane : lanes) {
+                hash = mix(hash, lane);
+            }
+            return hash;
+        }
+    };
+    
+    enum class compression {
+        none,
+        gzip,
+        zstd
+    };
+    
+    static compression compression_of_magic(const unsigned char* magic, size_t count) {
+        if (count >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) return compression::gzip;
+        if (count >= 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) {
+            return compression::zstd;
+        }
+        return compression::none;
+    }
+    
+    static compression compression_of_name(const std::string& filename) {
+        auto ends_with = [&](const char* suffix) {
+            size_t length = std::strlen(suffix);
+            return filename.size() >= length && filename.compare(filename.size() - length, length, suffix) == 0;
+        };
+        if (ends_with(".gz")) return compression::gzip;
+        if (ends_with(".zst")) return compression::zstd;
+        return compression::none;
+    }
+    
+    static bool compression_supported(compression kind) {
+        switch (kind) {
+#ifdef GAP_BUFFER_USE_ZLIB
+            case compression::gzip: return true;
+#endif
+#ifdef GAP_BUFFER_USE_ZSTD
+            case compression::zstd: return true;
+#endif
+            default: return false;
+        }
+    }
+    
+    static constexpr size_t compressed_chunk = size_t(1) << 18;
+    
+    // Decompress the whole of file into the (empty) buffer, writing each
+    // piece straight into the gap at the end. hint is the expected size.
+    bool read_compressed(std::ifstream& file, compression kind, size_t hint) {
+        std::vector<char> input(compressed_chunk);
+        reserve(hint);
+        
+#ifdef GAP_BUFFER_USE_ZLIB
+        if (kind == compression::gzip) {
+            z_stream stream{};
+            if (inflateInit2(&stream, 15 + 32) != Z_OK) return false;
+            
+            bool complete = false;
+            bool failed = false;
+            while (!failed) {
+                if (stream.avail_in == 0) {
+                    file.read(input.data(), static_cast<std::streamsize>(input.size()));
+                    stream.next_in = reinterpret_cast<Bytef*>(input.data());
+                    stream.avail_in = static_cast<uInt>(file.gcount());
+                    if (stream.avail_in == 0) break;
+                }
+                
+                auto gap = prepare_insert(size(), compressed_chunk);
+                size_t room = std::min(static_cast<size_t>(gap.second - gap.first), size_t(1) << 30);
+                stream.next_out = reinterpret_cast<Bytef*>(gap.first);
+                stream.avail_out = static_cast<uInt>(room);
+                int status = inflate(&stream, Z_NO_FLUSH);
+                gap_start += room - stream.avail_out;
+                
+                complete = status == Z_STREAM_END;
+                if (complete) {
+                    // Concatenated members (appended or rotated logs) read as one
+                    // text; anything else after a member, such as the zero padding
+                    // block tools add, ends it as with gzip -d
+                    if (stream.avail_in < 2) {
+                        std::memmove(input.data(), stream.next_in, stream.avail_in);
+                        file.read(input.data() + stream.avail_in,
+                                  static_cast<std::streamsize>(input.size() - stream.avail_in));
+                        stream.next_in = reinterpret_cast<Bytef*>(input.data());
+                        stream.avail_in += static_cast<uInt>(file.gcount());
+                    }
+                    if (stream.avail_in < 2 || stream.next_in[0] != 0x1F || stream.next_in[1] != 0x8B) break;
+                    inflateReset(&stream);
+                } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                    failed = true;
+                }
+            }
+            inflateEnd(&stream);
+            return complete && !failed;
+        }
+#endif
+#ifdef GAP_BUFFER_USE_ZSTD
+        if (kind == compression::zstd) {
+            ZSTD_DCtx* context = ZSTD_createDCtx();
+            if (!context) return false;
+            
+            size_t remaining = 1;  // ZSTD_decompressStream() returns 0 at the end of a frame
+            bool failed = false;
+            bool first = true;
+            while (!failed) {
+                file.read(input.data(), static_cast<std::streamsize>(input.size()));
+                size_t count = static_cast<size_t>(file.gcount());
+                if (count == 0) break;
+                
+                if (first) {
+                    // The frame header usually records the decompressed size
+                    unsigned long long content = ZSTD_getFrameContentSize(input.data(), count);
+                    if (content != ZSTD_CONTENTSIZE_UNKNOWN && content != ZSTD_CONTENTSIZE_ERROR) {
+                        reserve(static_cast<size_t>(content));
+                    }
+                    first = false;
+                }
+                
+                // A full output window may leave decoded bytes inside the
+                // context, so keep draining even once the input is used up,
+                // until the frame reports itself fully flushed (0)
+                ZSTD_inBuffer in{input.data(), count, 0};
+                bool full = false;
+                do {
+                    auto gap = prepare_insert(size(), std::max(compressed_chunk, ZSTD_DStreamOutSize()));
+                    ZSTD_outBuffer out{gap.first, static_cast<size_t>(gap.second - gap.first), 0};
+                    remaining = ZSTD_decompressStream(context, &out, &in);
+                    failed = ZSTD_isError(remaining) != 0;
+                    if (!failed) gap_start += out.pos;
+                    full = out.pos == out.size;
+                } while (!failed && (in.pos < in.size || (full && remaining != 0)));
+            }
+            ZSTD_freeDCtx(context);
+            return remaining == 0 && !failed;
+        }
+#endif
+        (void)file;
+        (void)kind;
+        return false;
+    }
+    
+    // Compress the text to file straight from the two runs around the gap
+    bool write_compressed(std::ofstream& file, compression kind) const {
+        std::vector<char> output(compressed_chunk);
+        std::pair<const char*, size_t> runs[2] = {{buffer, gap_start},
+                                                  {buffer + gap_end, buffer_size - gap_end}};
+        
+#ifdef GAP_BUFFER_USE_ZLIB
+        if (kind == compression::gzip) {
+            z_stream stream{};
+            if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                return false;
+            }
+            
+            // Feed both runs, at most 1 GB per call, then drain with Z_FINISH
+            int status = Z_OK;
+            for (int pass = 0; pass < 3 && status != Z_STREAM_ERROR; ++pass) {
+                const char* data = pass < 2 ? runs[pass].first : nullptr;
+                size_t left = pass < 2 ? runs[pass].second : 0;
+                int flush = pass < 2 ? Z_NO_FLUSH : Z_FINISH;
+                do {
+                    size_t take = std::min(left, size_t(1) << 30);
+                    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+                    stream.avail_in = static_cast<uInt>(take);
+                    do {
+                        stream.next_out = reinterpret_cast<Bytef*>(output.data());
+                        stream.avail_out = static_cast<uInt>(output.size());
+                        status = deflate(&stream, flush);
+                        file.write(output.data(), static_cast<std::streamsize>(output.size() - stream.avail_out));
+                    } while (stream.avail_out == 0 && status != Z_STREAM_ERROR);
+                    data += take;
+                    left -= take;
+                } while (left > 0 && status != Z_STREAM_ERROR);
+            }
+            deflateEnd(&stream);
+            return status == Z_STREAM_END && file.good();
+        }
+#endif
+#ifdef GAP_BUFFER_USE_ZSTD
+        if (kind == compression::zstd) {
+            ZSTD_CCtx* context = ZSTD_createCCtx();
+            if (!context) return false;
+            ZSTD_CCtx_setPledgedSrcSize(context, size());
+            
+            bool failed = false;
+            size_t remaining = 0;
+            for (int pass = 0; pass < 3 && !failed; ++pass) {
+                ZSTD_inBuffer in{pass < 2 ? runs[pass].first : nullptr, pass < 2 ? runs[pass].second : 0, 0};
+                ZSTD_EndDirective mode = pass < 2 ? ZSTD_e_continue : ZSTD_e_end;
+                do {
+                    ZSTD_outBuffer out{output.data(), output.size(), 0};
+                    remaining = ZSTD_compressStream2(context, &out, &in, mode);
+                    failed = ZSTD_isError(remaining) != 0;
+                    if (!failed) file.write(output.data(), static_cast<std::streamsize>(out.pos));
+                } while (!failed && (mode == ZSTD_e_end ? remaining != 0 : in.pos < in.size));
+            }
+            ZSTD_freeCCtx(context);
+            return !failed && file.good();
+        }
+#endif
+        (void)file;
+        (void)kind;
+        (void)runs;
+        return false;
     }
     
     // Enhanced UTF-8 validation
@@ -869,10 +2965,33 @@ public:
     };
     
     // Constructors
-    text_editor_buffer() : gap_buffer<char>(), cursor_pos(0), line_starts(), line_cache_valid(false) {}
+    text_editor_buffer() : gap_buffer<char>(), cursor_pos(0), line_starts(), line_cache_valid(false),
+          wrap_width(0), visual_rows(), wrap_index_valid(false),
+          folds(), visible_lines(), fold_index_valid(false),
+          dirty_lines(1, line_range{0, to_end}), max_lines(0), journal(nullptr) {}
     
     explicit text_editor_buffer(const std::string& text) 
-        : gap_buffer<char>(text.begin(), text.end()), cursor_pos(0), line_starts(), line_cache_valid(false) {}
+        : gap_buffer<char>(text.data(), text.data() + text.size()), cursor_pos(0), line_starts(), line_cache_valid(false),
+          wrap_width(0), visual_rows(), wrap_index_valid(false),
+          folds(), visible_lines(), fold_index_valid(false),
+          dirty_lines(1, line_range{0, to_end}), max_lines(0), journal(nullptr) {}
+    
+    // Adopt text in storage from std::allocator<char> (e.g. a network
+    // receive buffer) without copying it
+    text_editor_buffer(adopt_storage_t, char* data, size_t size, size_t capacity)
+        : gap_buffer<char>(adopt_storage, data, size, capacity), cursor_pos(0), line_starts(), line_cache_valid(false),
+          wrap_width(0), visual_rows(), wrap_index_valid(false),
+          folds(), visible_lines(), fold_index_valid(false),
+          dirty_lines(1, line_range{0, to_end}), max_lines(0), journal(nullptr) {}
+    
+    // Give the text back as raw storage, leaving the buffer empty
+    storage_block release() {
+        storage_block block = gap_buffer<char>::release();
+        cursor_pos = 0;
+        folds.clear();
+        invalidate_line_cache();
+        return block;
+    }
     
     // Cursor position management
     size_t get_cursor_position() const noexcept {
@@ -891,13 +3010,12 @@ public:
         }
         
         // Binary search for line
-        auto it = std::upper_bound(line_starts.begin(), line_starts.end(), cursor_pos);
-        if (it != line_starts.begin()) {
-            --it;
+        size_t line = line_starts.upper_bound(cursor_pos);
+        if (line != 0) {
+            --line;
         }
         
-        size_t line = std::distance(line_starts.begin(), it);
-        size_t column = cursor_pos - *it;
+        size_t column = cursor_pos - line_starts[line];
         
         return cursor_position(line, column, cursor_pos);
     }
@@ -964,6 +3082,240 @@ public:
         return result;
     }
     
+    // Soft wrap: each line occupies ceil(code points / width) visual rows
+    // (at least one). 0 disables wrapping. The index is kept up to date
+    // through edits, so the queries below are O(log n) plus the length of
+    // one line.
+    void set_wrap_width(size_t width) {
+        if (width == wrap_width) return;
+        
+        wrap_width = width;
+        wrap_index_valid = false;
+        mark_dirty(0, to_end);
+        update_wrap_index();
+    }
+    
+    size_t get_wrap_width() const noexcept {
+        return wrap_width;
+    }
+    
+    size_t get_visual_line_count() const {
+        if (wrap_width == 0) return get_line_count();
+        
+        update_wrap_index();
+        return visual_rows.total();
+    }
+    
+    size_t visual_row_of_position(size_t pos) const {
+        pos = std::min(pos, size());
+        text_point point = point_at(pos);
+        if (wrap_width == 0) return point.row;
+        
+        update_wrap_index();
+        // A position inside a multi-byte character belongs to its row
+        while (pos > line_begin(point.row) && pos < size() &&
+               is_utf8_continuation(static_cast<unsigned char>((*this)[pos]))) {
+            --pos;
+        }
+        size_t column = count_code_points(line_begin(point.row), pos);
+        size_t row_in_line = std::min(column / wrap_width, visual_rows.value(point.row) - 1);
+        return visual_rows.prefix(point.row) + row_in_line;
+    }
+    
+    // First position shown on a visual row; size() past the last row
+    size_t position_of_visual_row(size_t row) const {
+        update_line_cache();
+        if (wrap_width == 0) {
+            return row < line_starts.size() ? line_starts[row] : size();
+        }
+        
+        update_wrap_index();
+        size_t line = visual_rows.find(row);
+        if (line >= line_starts.size()) return size();
+        
+        size_t row_in_line = row - visual_rows.prefix(line);
+        return advance_code_points(line_begin(line), row_in_line * wrap_width, line_end(line));
+    }
+    
+    // Lines to redraw since the previous call: those edited, plus everything
+    // from the first line whose number shifted (to_end). Starts out as the
+    // whole document, and an edit made while the line cache is stale (e.g.
+    // right after a load) marks the whole document as well.
+    std::vector<line_range> take_dirty_lines() {
+        std::vector<line_range> taken;
+        taken.swap(dirty_lines);
+        return taken;
+    }
+    
+    bool has_dirty_lines() const noexcept {
+        return !dirty_lines.empty();
+    }
+    
+    // Code folding: a fold keeps its first line visible and hides the lines
+    // after it up to its last line. Folds may nest or overlap and follow the
+    // text through edits; a fold whose lines are deleted disappears. Visible
+    // and buffer line numbers convert in O(log n).
+    bool add_fold(size_t first_line, size_t last_line) {
+        update_line_cache();
+        if (first_line >= last_line || last_line >= line_starts.size()) return false;
+        
+        folds.push_back(fold_marker{line_begin(first_line), line_end(last_line)});
+        fold_index_valid = false;
+        mark_dirty(first_line, to_end);
+        return true;
+    }
+    
+    // Remove the innermost fold headed at first_line
+    bool remove_fold(size_t first_line) {
+        update_line_cache();
+        
+        auto innermost = folds.end();
+        for (auto it = folds.begin(); it != folds.end(); ++it) {
+            if (line_of(it->start) == first_line &&
+                (innermost == folds.end() || it->end < innermost->end)) {
+                innermost = it;
+            }
+        }
+        if (innermost == folds.end()) return false;
+        
+        folds.erase(innermost);
+        fold_index_valid = false;
+        mark_dirty(first_line, to_end);
+        return true;
+    }
+    
+    void clear_folds() {
+        if (folds.empty()) return;
+        
+        folds.clear();
+        fold_index_valid = false;
+        mark_dirty(0, to_end);
+    }
+    
+    std::vector<fold_range> get_folds() const {
+        update_line_cache();
+        
+        std::vector<fold_range> result;
+        result.reserve(folds.size());
+        for (const auto& fold : folds) {
+            result.push_back(fold_range{line_of(fold.start), line_of(fold.end)});
+        }
+        return result;
+    }
+    
+    bool is_line_visible(size_t line) const {
+        if (folds.empty()) return line < get_line_count();
+        
+        update_fold_index();
+        return line < visible_lines.size() && visible_lines.value(line) == 1;
+    }
+    
+    size_t get_visible_line_count() const {
+        if (folds.empty()) return get_line_count();
+        
+        update_fold_index();
+        return visible_lines.total();
+    }
+    
+    // Buffer line shown on a visible row; get_line_count() past the last one
+    size_t visible_to_buffer_line(size_t visible_line) const {
+        if (folds.empty()) return std::min(visible_line, get_line_count());
+        
+        update_fold_index();
+        return visible_lines.find(visible_line);
+    }
+    
+    // Visible row of a line; a hidden line maps to the row of its fold header
+    size_t buffer_to_visible_line(size_t line) const {
+        if (folds.empty()) return std::min(line, get_line_count());
+        
+        update_fold_index();
+        if (line >= visible_lines.size()) return visible_lines.total();
+        
+        size_t before = visible_lines.prefix(line);
+        return visible_lines.value(line) == 1 ? before : before - 1;
+    }
+    
+    // Largest contiguous run of text starting at offset (up to the gap or
+    // the end), for parsers that pull input chunk by chunk; empty at or past
+    // the end. Valid until the next modification.
+    std::string_view read_chunk(size_t offset) const {
+        if (offset >= size()) return std::string_view();
+        
+        auto run = chunk_at(offset);
+        return std::string_view(run.first, run.second - run.first);
+    }
+    
+    // Called with the edit that was applied after every mutator:
+    // insert_text/delete_text (and so replace_text), commit_insert, splice,
+    // and replace_all_regex/convert_line_endings (reported as one edit
+    // spanning the whole text). Loading text is not an edit.
+    void set_edit_callback(edit_callback callback) {
+        on_edit = std::move(callback);
+    }
+    
+    // Log every edit (the same ones the callback sees) to target, or stop
+    // with nullptr. Attach or reopen the journal after loading. Copies of
+    // the buffer log to the same journal until given their own.
+    void set_journal(edit_journal* target) {
+        journal = target;
+    }
+    
+    edit_journal* get_journal() const noexcept {
+        return journal;
+    }
+    
+    // Rebuild unsaved work after a crash: load filename as it was when the
+    // journal was started and replay the intact records on top. Fails, with
+    // the buffer untouched, when filename has been saved since.
+    bool recover_from_journal(const std::string& filename, const std::string& journal_filename) {
+        edit_journal* attached = journal;
+        journal = nullptr;
+        
+        bool recovered = edit_journal::replay(journal_filename, filename,
+            [&](bool base_exists) {
+                if (base_exists) return load_from_file(filename);
+                clear();
+                cursor_pos = 0;
+                folds.clear();
+                invalidate_line_cache();
+                return true;
+            },
+            [&](edit_journal::record_kind kind, size_t pos, size_t count, std::string_view text) {
+                if (pos > size()) return false;
+                if (kind == edit_journal::record_kind::insert) {
+                    insert_text(pos, std::string(text));
+                } else {
+                    if (count > size() - pos) return false;
+                    delete_text(pos, count);
+                }
+                return true;
+            });
+        
+        journal = attached;
+        return recovered;
+    }
+    
+    // Zero-copy views; they stay valid until the next modification
+    std::string_view get_text_view(size_t pos, size_t count) {
+        if (pos >= size()) return std::string_view();
+        
+        auto range = contiguous_view(pos, count);
+        return std::string_view(range.first, range.second - range.first);
+    }
+    
+    std::string_view get_line_view(size_t line) {
+        update_line_cache();
+        
+        if (line >= line_starts.size()) return std::string_view();
+        
+        size_t start = line_starts[line];
+        size_t end = (line + 1 < line_starts.size()) ? 
+                     line_starts[line + 1] - 1 : size();
+        
+        return get_text_view(start, end - start);
+    }
+    
     // Text manipulation
     void insert_text(const std::string& text) {
         insert_text(cursor_pos, text);
@@ -972,20 +3324,27 @@ public:
     void insert_text(size_t pos, const std::string& text) {
         if (text.empty()) return;
         
+        text_point start = on_edit ? point_at(pos) : text_point{};
+        
         auto it = begin() + pos;
-        insert(it, text.begin(), text.end());
+        insert(it, text.data(), text.data() + text.size());
         
         if (pos <= cursor_pos) {
             cursor_pos += text.length();
         }
         
-        invalidate_line_cache();
+        text_inserted(pos, text);
+        notify_edit(pos, pos, pos + text.length(), start, start);
     }
     
     void delete_text(size_t pos, size_t count) {
         if (pos >= size() || count == 0) return;
         
         count = std::min(count, size() - pos);
+        
+        text_point start = on_edit ? point_at(pos) : text_point{};
+        text_point old_end = on_edit ? point_at(pos + count) : text_point{};
+        
         auto start_it = begin() + pos;
         auto end_it = start_it + count;
         
@@ -996,7 +3355,74 @@ public:
                          cursor_pos - count : pos;
         }
         
-        invalidate_line_cache();
+        text_erased(pos, count);
+        notify_edit(pos, pos + count, pos, start, old_end);
+    }
+    
+    // Text written through prepare_insert() becomes visible here
+    void commit_insert(size_t count) {
+        size_t pos = gap_start;
+        text_point start = on_edit ? point_at(pos) : text_point{};
+        
+        gap_buffer<char>::commit_insert(count);
+        
+        if (pos <= cursor_pos) {
+            cursor_pos += count;
+        }
+        
+        text_inserted(pos, std::string_view(buffer + pos, count));
+        notify_edit(pos, pos, pos + count, start, start);
+        trim_to_max_lines();
+    }
+    
+    // Streaming ingestion (process output, sockets): the gap stays at the
+    // end and only the new text is scanned for line breaks
+    void append(std::string_view text) {
+        if (text.empty()) return;
+        
+        auto gap = prepare_insert(size(), text.size());
+        std::memcpy(gap.first, text.data(), text.size());
+        commit_insert(text.size());
+    }
+    
+    // Bounded scrollback: once appended text (append, commit_insert,
+    // file_follower) takes the buffer past lines lines, the oldest lines are
+    // dropped in O(1) amortized time. 0 removes the cap.
+    void set_max_lines(size_t lines) {
+        max_lines = lines;
+        trim_to_max_lines();
+    }
+    
+    size_t get_max_lines() const noexcept {
+        return max_lines;
+    }
+    
+    // Cut count characters at src_pos from src and paste them at pos without
+    // an intermediate string
+    void splice(size_t pos, text_editor_buffer& src, size_t src_pos, size_t count) {
+        if (pos > size() || src_pos >= src.size() || count == 0) return;
+        
+        count = std::min(count, src.size() - src_pos);
+        
+        text_point start = on_edit ? point_at(pos) : text_point{};
+        text_point src_start = src.on_edit ? src.point_at(src_pos) : text_point{};
+        text_point src_old_end = src.on_edit ? src.point_at(src_pos + count) : text_point{};
+        
+        gap_buffer<char>::splice(pos, src, src_pos, count);
+        
+        if (pos <= cursor_pos) {
+            cursor_pos += count;
+        }
+        if (src_pos < src.cursor_pos) {
+            src.cursor_pos = (src.cursor_pos >= src_pos + count) ? 
+                             src.cursor_pos - count : src_pos;
+        }
+        
+        // The pasted text sits just before our gap
+        text_inserted(pos, std::string_view(buffer + pos, count));
+        src.text_erased(src_pos, count);
+        notify_edit(pos, pos, pos + count, start, start);
+        src.notify_edit(src_pos, src_pos + count, src_pos, src_start, src_old_end);
     }
     
     void replace_text(size_t pos, size_t count, const std::string& replacement) {
@@ -1141,10 +3567,13 @@ public:
             std::string result = std::regex_replace(buffer_text, regex_pattern, replacement);
             
             if (result != original_text) {
-                // Replace buffer contents
-                clear();
-                assign(result.begin(), result.end());
+                // Replace buffer contents, keeping folds on the same lines
+                std::vector<fold_range> kept_folds = get_folds();
+                text_point old_end_point = point_at(original_text.size());
+                assign(result.data(), result.data() + result.size());
                 invalidate_line_cache();
+                restore_folds(kept_folds);
+                notify_edit(0, original_text.size(), size(), text_point{0, 0}, old_end_point);
                 
                 // Estimate replacement count
                 std::sregex_iterator iter(original_text.begin(), original_text.end(), regex_pattern);
@@ -1174,43 +3603,249 @@ public:
             // Clear buffer and read file
             clear();
             
-            if (file_size > 0) {
+            unsigned char magic[4] = {};
+            file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+            compression kind = compression_of_magic(magic, static_cast<size_t>(file.gcount()));
+            file.clear();
+            file.seekg(0, std::ios::beg);
+            
+            bool loaded = true;
+            if (compression_supported(kind)) {
+                // gzip keeps the size mod 2^32 in its last four bytes (bounded
+                // by deflate's 1032:1 limit); text usually compresses 4:1
+                size_t hint = static_cast<size_t>(file_size) * 4;
+                if (kind == compression::gzip && file_size >= 4) {
+                    unsigned char tail[4];
+                    file.seekg(-4, std::ios::end);
+                    file.read(reinterpret_cast<char*>(tail), sizeof(tail));
+                    file.seekg(0, std::ios::beg);
+                    size_t stored = uint32_t(tail[0]) | uint32_t(tail[1]) << 8 |
+                                    uint32_t(tail[2]) << 16 | uint32_t(tail[3]) << 24;
+                    hint = std::min(std::max(stored, static_cast<size_t>(file_size)),
+                                    static_cast<size_t>(file_size) * 1032);
+                }
+                loaded = read_compressed(file, kind, hint);
+                if (!loaded) clear();
+            } else if (file_size > 0) {
                 reserve(static_cast<size_t>(file_size));
                 
-                std::vector<char> temp_buffer(static_cast<size_t>(file_size));
-                file.read(temp_buffer.data(), file_size);
+                // Read straight into the (empty) buffer's gap
+                file.read(buffer, file_size);
                 
                 std::streamsize bytes_read = file.gcount();
                 if (bytes_read > 0) {
-                    assign(temp_buffer.begin(), temp_buffer.begin() + bytes_read);
+                    gap_start = static_cast<size_t>(bytes_read);
                 }
             }
             
             cursor_pos = 0;
+            folds.clear();
             invalidate_line_cache();
-            return true;
+            return loaded;
         } catch (const std::exception&) {
             return false;
         }
     }
     
+    // A .gz or .zst name is written compressed when that codec is built in
     bool save_to_file(const std::string& filename) const {
         std::ofstream file(filename, std::ios::binary);
         if (!file.is_open()) return false;
         
         try {
-            // Write gap buffer contents sequentially
-            for (size_t i = 0; i < size(); ++i) {
-                file.put((*this)[i]);
-                if (file.fail()) return false;
+            compression kind = compression_of_name(filename);
+            if (compression_supported(kind)) {
+                return write_compressed(file, kind);
             }
             
+            // Write the runs on either side of the gap
+            file.write(buffer, static_cast<std::streamsize>(gap_start));
+            file.write(buffer + gap_end, static_cast<std::streamsize>(buffer_size - gap_end));
             return file.good();
         } catch (const std::exception&) {
             return false;
         }
     }
     
+    // Write the line index to a sidecar file, stamped with the size, mtime
+    // and a sampled hash of filename, which must hold the buffer's text (as
+    // right after load_from_file or save_to_file)
+    bool save_line_index(const std::string& filename, const std::string& index_filename) const {
+        line_index_header header{};
+        std::memcpy(header.magic, line_index_magic, sizeof(header.magic));
+        header.version = line_index_version;
+        header.entry_size = size() <= UINT32_MAX ? 4 : 8;
+        if (!file_identity(filename, header.file_size, header.mtime)) return false;
+        header.sample_hash = sample_hash();
+        
+        update_line_cache();
+        header.line_count = line_starts.size();
+        
+        // Written under a temporary name so a reader never maps half a file
+        std::string temp_filename = index_filename + ".tmp";
+        {
+            std::ofstream file(temp_filename, std::ios::binary);
+            if (!file.is_open()) return false;
+            
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            encode_line_starts(header.entry_size, [&](const unsigned char* data, size_t bytes) {
+                file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            });
+            if (!file.good()) return false;
+        }
+        
+        std::error_code error;
+        std::filesystem::rename(temp_filename, index_filename, error);
+        return !error;
+    }
+    
+    // Install a line index saved by save_line_index, skipping the scan of
+    // the text. Fails, leaving the cache alone, unless the sidecar matches
+    // filename on disk and the buffer's text.
+    bool load_line_index(const std::string& filename, const std::string& index_filename) {
+        line_index_header expected{};
+        if (!file_identity(filename, expected.file_size, expected.mtime)) return false;
+        
+        auto matches = [&](const line_index_header& header) {
+            return std::memcmp(header.magic, line_index_magic, sizeof(header.magic)) == 0 &&
+                   header.version == line_index_version &&
+                   (header.entry_size == 4 || header.entry_size == 8) &&
+                   header.file_size == expected.file_size && header.mtime == expected.mtime &&
+                   header.sample_hash == sample_hash();
+        };
+        
+        return with_file_bytes(index_filename, [&](const unsigned char* bytes, size_t length) {
+            line_index_header header;
+            if (length < sizeof(header)) return false;
+            std::memcpy(&header, bytes, sizeof(header));
+            
+            std::vector<size_t> starts;
+            if (!matches(header) ||
+                !decode_line_starts(bytes + sizeof(header), length - sizeof(header),
+                                    header.line_count, header.entry_size, size(), starts)) return false;
+            install_line_starts(std::move(starts));
+            return true;
+        });
+    }
+    
+    // Write the whole editing state (text with its gap position, line index,
+    // cursor, folds, wrap width and line cap) to one file
+    bool save_session(const std::string& filename) const {
+        update_line_cache();
+        
+        session_header header{};
+        std::memcpy(header.magic, session_magic, sizeof(header.magic));
+        header.version = session_version;
+        header.entry_size = size() <= UINT32_MAX ? 4 : 8;
+        header.text_size = size();
+        header.gap_position = gap_start;
+        header.cursor = cursor_pos;
+        header.wrap_width = wrap_width;
+        header.max_lines = max_lines;
+        header.line_count = line_starts.size();
+        header.fold_count = folds.size();
+        
+        std::string temp_filename = filename + ".tmp";
+        {
+            std::ofstream file(temp_filename, std::ios::binary);
+            if (!file.is_open()) return false;
+            
+            // The header goes last, once the checksum is known
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            word_checksum checksum;
+            checksum.update(reinterpret_cast<const unsigned char*>(&header), sizeof(header));
+            auto emit = [&](const void* data, size_t bytes) {
+                file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+                checksum.update(static_cast<const unsigned char*>(data), bytes);
+            };
+            auto pad = [&](size_t bytes) {
+                static const unsigned char zeros[8] = {};
+                emit(zeros, (8 - bytes % 8) % 8);
+            };
+            
+            emit(buffer, gap_start);
+            emit(buffer + gap_end, buffer_size - gap_end);
+            pad(size());
+            encode_line_starts(header.entry_size, emit);
+            pad(line_starts.size() * header.entry_size);
+            for (const auto& fold : folds) {
+                uint64_t range[2] = {fold.start, fold.end};
+                emit(range, sizeof(range));
+            }
+            
+            header.checksum = checksum.finish();
+            file.seekp(0);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            if (!file.good()) return false;
+        }
+        
+        std::error_code error;
+        std::filesystem::rename(temp_filename, filename, error);
+        return !error;
+    }
+    
+    // Restore a session written by save_session. The text is copied from
+    // the mapped file straight into storage around the saved gap, and the
+    // line index is installed without a scan. Nothing changes unless the
+    // file is complete and its checksum matches.
+    bool load_session(const std::string& filename) {
+        return with_file_bytes(filename, [&](const unsigned char* bytes, size_t length) {
+            session_header header;
+            if (length < sizeof(header)) return false;
+            std::memcpy(&header, bytes, sizeof(header));
+            if (std::memcmp(header.magic, session_magic, sizeof(header.magic)) != 0 ||
+                header.version != session_version ||
+                (header.entry_size != 4 && header.entry_size != 8)) return false;
+            
+            // Bound each count by the file length before multiplying
+            size_t payload = length - sizeof(header);
+            if (header.text_size > payload || header.line_count > payload / header.entry_size ||
+                header.fold_count > payload / 16 || header.gap_position > header.text_size) return false;
+            auto padded = [](uint64_t bytes) { return (bytes + 7) / 8 * 8; };
+            uint64_t text_bytes = padded(header.text_size);
+            uint64_t line_bytes = padded(header.line_count * header.entry_size);
+            if (text_bytes + line_bytes + header.fold_count * 16 != payload) return false;
+            
+            session_header zeroed = header;
+            zeroed.checksum = 0;
+            word_checksum checksum;
+            checksum.update(reinterpret_cast<const unsigned char*>(&zeroed), sizeof(zeroed));
+            checksum.update(bytes + sizeof(header), payload);
+            if (checksum.finish() != header.checksum) return false;
+            
+            const unsigned char* text = bytes + sizeof(header);
+            size_t count = static_cast<size_t>(header.text_size);
+            std::vector<size_t> starts;
+            if (!decode_line_starts(text + text_bytes, static_cast<size_t>(line_bytes),
+                                    header.line_count, header.entry_size, count, starts)) return false;
+            
+            std::vector<fold_marker> markers(static_cast<size_t>(header.fold_count));
+            const unsigned char* ranges = text + text_bytes + line_bytes;
+            for (size_t i = 0; i < markers.size(); ++i) {
+                uint64_t range[2];
+                std::memcpy(range, ranges + i * sizeof(range), sizeof(range));
+                if (range[0] > range[1] || range[1] > count) return false;
+                markers[i] = fold_marker{static_cast<size_t>(range[0]), static_cast<size_t>(range[1])};
+            }
+            
+            size_t before = static_cast<size_t>(header.gap_position);
+            size_t after = count - before;
+            clear();
+            reserve(count);
+            if (before > 0) std::memcpy(buffer, text, before);
+            gap_start = before;
+            gap_end = buffer_size - after;
+            if (after > 0) std::memcpy(buffer + gap_end, text + before, after);
+            
+            cursor_pos = std::min(static_cast<size_t>(header.cursor), count);
+            folds = std::move(markers);
+            wrap_width = static_cast<size_t>(header.wrap_width);
+            max_lines = static_cast<size_t>(header.max_lines);
+            install_line_starts(std::move(starts));
+            return true;
+        });
+    }
+    
     // Line ending conversion
     enum class line_ending_type {
         LF,      // Unix/Linux/macOS (\n)
@@ -1252,10 +3887,26 @@ public:
             }
         }
         
-        // Replace buffer contents
-        clear();
-        assign(result.begin(), result.end());
+        // Replace buffer contents, keeping folds on the same lines
+        std::vector<fold_range> kept_folds = get_folds();
+        text_point old_end_point = point_at(buffer_text.size());
+        assign(result.data(), result.data() + result.size());
         invalidate_line_cache();
+        restore_folds(kept_folds);
+        notify_edit(0, buffer_text.size(), size(), text_point{0, 0}, old_end_point);
+    }
+    
+    // parallel_transform on an editor buffer: op may add or remove line
+    // breaks, so the caches are rebuilt and the rewrite is reported as one
+    // edit over the whole text, like convert_line_endings
+    template <typename UnaryOp>
+    friend void parallel_transform(text_editor_buffer& buf, UnaryOp op, unsigned threads = 0) {
+        std::vector<fold_range> kept_folds = buf.get_folds();
+        text_point old_end_point = buf.point_at(buf.size());
+        parallel_transform(static_cast<gap_buffer<char>&>(buf), op, threads);
+        buf.invalidate_line_cache();
+        buf.restore_folds(kept_folds);
+        buf.notify_edit(0, buf.size(), buf.size(), text_point{0, 0}, old_end_point);
     }
     
     line_ending_type detect_line_ending() const {
@@ -1498,4 +4149,327 @@ public:
     }
 };
 
+// Stream buffer over a gap_buffer<char> or text_editor_buffer. Reads come
+// straight from the two storage segments, and output is appended through
+// the gap, so std::istream/std::ostream need no intermediate string. Pending
+// output is committed on flush (sync) and before every read; modify the
+// buffer directly only after flushing.
+template <typename Buffer = gap_buffer<char>>
+class gap_streambuf : public std::streambuf {
+private:
+    Buffer& buf;
+    size_t get_base;  // Logical position of eback()
+    
+    size_t get_position() const {
+        return get_base + static_cast<size_t>(gptr() - eback());
+    }
+    
+    // Forget the get area; the next read re-fetches from the logical position
+    void reset_get_area(size_t pos) {
+        get_base = pos;
+        setg(nullptr, nullptr, nullptr);
+    }
+    
+    void commit_put() {
+        if (pptr() > pbase()) {
+            size_t pos = get_position();
+            buf.commit_insert(static_cast<size_t>(pptr() - pbase()));
+            reset_get_area(pos);
+        }
+        setp(nullptr, nullptr);
+    }
+    
+public:
+    explicit gap_streambuf(Buffer& buffer) : buf(buffer), get_base(0) {
+        setg(nullptr, nullptr, nullptr);
+        setp(nullptr, nullptr);
+    }
+    
+    gap_streambuf(const gap_streambuf&) = delete;
+    gap_streambuf& operator=(const gap_streambuf&) = delete;
+    
+    ~gap_streambuf() override {
+        commit_put();
+    }
+    
+protected:
+    int_type underflow() override {
+        commit_put();
+        
+        size_t pos = get_position();
+        if (pos >= buf.size()) {
+            return traits_type::eof();
+        }
+        
+        // The stream never writes through the get area
+        auto run = buf.chunk_at(pos);
+        char* first = const_cast<char*>(run.first);
+        get_base = pos;
+        setg(first, first, const_cast<char*>(run.second));
+        return traits_type::to_int_type(*gptr());
+    }
+    
+    std::streamsize showmanyc() override {
+        commit_put();
+        size_t pos = get_position();
+        return pos < buf.size() ? static_cast<std::streamsize>(buf.size() - pos) : -1;
+    }
+    
+    // Copy segment by segment
+    std::streamsize xsgetn(char* s, std::streamsize n) override {
+        std::streamsize done = 0;
+        while (done < n) {
+            if (gptr() == egptr() && traits_type::eq_int_type(underflow(), traits_type::eof())) {
+                break;
+            }
+            std::streamsize chunk = std::min<std::streamsize>(n - done, egptr() - gptr());
+            std::memcpy(s + done, gptr(), static_cast<size_t>(chunk));
+            setg(eback(), gptr() + chunk, egptr());
+            done += chunk;
+        }
+        return done;
+    }
+    
+    // The free gap at the end of the buffer serves as the put area
+    int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return traits_type::not_eof(ch);
+        }
+        
+        commit_put();
+        size_t pos = get_position();
+        auto gap = buf.prepare_insert(buf.size(), 1);
+        reset_get_area(pos);
+        
+        setp(gap.first, gap.second);
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+        return ch;
+    }
+    
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if (n <= 0) return 0;
+        
+        commit_put();
+        size_t pos = get_position();
+        auto gap = buf.prepare_insert(buf.size(), static_cast<size_t>(n));
+        std::memcpy(gap.first, s, static_cast<size_t>(n));
+        buf.commit_insert(static_cast<size_t>(n));
+        reset_get_area(pos);
+        return n;
+    }
+    
+    int sync() override {
+        commit_put();
+        return 0;
+    }
+    
+    // Reads can seek anywhere; writes always append
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override {
+        commit_put();
+        
+        if (which & std::ios_base::in) {
+            off_type base = dir == std::ios_base::beg ? 0 :
+                            dir == std::ios_base::cur ? static_cast<off_type>(get_position()) :
+                            static_cast<off_type>(buf.size());
+            off_type target = base + off;
+            if (target < 0 || target > static_cast<off_type>(buf.size())) {
+                return pos_type(off_type(-1));
+            }
+            reset_get_area(static_cast<size_t>(target));
+            return pos_type(target);
+        }
+        
+        if ((which & std::ios_base::out) && off == 0 && dir != std::ios_base::beg) {
+            return pos_type(static_cast<off_type>(buf.size()));
+        }
+        return pos_type(off_type(-1));
+    }
+    
+    pos_type seekpos(pos_type pos,
+                     std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+// Follows a growing file like tail -f. New bytes are read straight into the
+// gap at the end of the buffer and only they are scanned for line starts,
+// so line counts stay live without re-indexing. Changes are picked up with
+// inotify on Linux and by stat polling elsewhere; call poll() from the event
+// loop (on Linux native_handle() becomes readable when the file changes).
+// A file that shrinks or is replaced (log rotation) is reloaded from the start.
+class file_follower {
+private:
+    text_editor_buffer& buf;
+    std::string path;
+    std::ifstream stream;
+    size_t offset;   // Bytes of the file already in the buffer
+    bool active;
+    unsigned long long file_id;  // Inode where available, to spot replacement
+#ifdef __linux__
+    int notify_fd;
+    int watch;
+#endif
+    
+    static unsigned long long identify(const std::string& filename) {
+#if defined(__unix__) || defined(__APPLE__)
+        struct stat info;
+        if (::stat(filename.c_str(), &info) == 0) {
+            return static_cast<unsigned long long>(info.st_ino) ^
+                   (static_cast<unsigned long long>(info.st_dev) << 32);
+        }
+#else
+        (void)filename;
+#endif
+        return 0;
+    }
+    
+    void add_watch() {
+#ifdef __linux__
+        if (notify_fd < 0) return;
+        if (watch >= 0) ::inotify_rm_watch(notify_fd, watch);
+        watch = ::inotify_add_watch(notify_fd, path.c_str(),
+                                    IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+#endif
+    }
+    
+    bool reload() {
+        // Watch first so nothing written during the load goes unnoticed
+        add_watch();
+        
+        stream.close();
+        if (!buf.load_from_file(path)) return false;
+        
+        stream.open(path, std::ios::binary);
+        offset = buf.size();
+        file_id = identify(path);
+        buf.set_max_lines(buf.get_max_lines());  // The cap holds from the start, not the next append
+        buf.get_line_count();  // Build the line index once; appends extend it
+        return stream.is_open();
+    }
+    
+    // Pull in whatever the file gained since the last call
+    size_t catch_up(bool replaced) {
+        std::error_code error;
+        auto file_size = std::filesystem::file_size(path, error);
+        if (error) return 0;  // Missing for a moment during rotation
+        
+        if (replaced || file_size < offset || identify(path) != file_id) {
+            size_t before = buf.size();
+            return reload() ? buf.size() : before;
+        }
+        if (file_size == offset) return 0;
+        
+        size_t wanted = static_cast<size_t>(file_size) - offset;
+        stream.clear();
+        stream.seekg(static_cast<std::streamoff>(offset));
+        
+        auto gap = buf.prepare_insert(buf.size(), wanted);
+        stream.read(gap.first, static_cast<std::streamsize>(wanted));
+        size_t got = static_cast<size_t>(std::max<std::streamsize>(stream.gcount(), 0));
+        buf.commit_insert(got);
+        offset += got;
+        return got;
+    }
+    
+public:
+    explicit file_follower(text_editor_buffer& buffer)
+        : buf(buffer), path(), stream(), offset(0), active(false), file_id(0)
+#ifdef __linux__
+          , notify_fd(-1), watch(-1)
+#endif
+    {}
+    
+    file_follower(const file_follower&) = delete;
+    file_follower& operator=(const file_follower&) = delete;
+    
+    ~file_follower() {
+        close();
+    }
+    
+    // Load the file and start following it
+    bool open(const std::string& filename) {
+        close();
+        path = filename;
+#ifdef __linux__
+        notify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+        active = reload();
+        if (!active) close();
+        return active;
+    }
+    
+    void close() {
+        stream.close();
+        active = false;
+#ifdef __linux__
+        if (notify_fd >= 0) ::close(notify_fd);
+        notify_fd = -1;
+        watch = -1;
+#endif
+    }
+    
+    bool is_open() const noexcept {
+        return active;
+    }
+    
+    // Descriptor to wait on in an event loop, or -1 when polling
+    int native_handle() const noexcept {
+#ifdef __linux__
+        return watch >= 0 ? notify_fd : -1;
+#else
+        return -1;
+#endif
+    }
+    
+    // Wait up to timeout_ms for the file to change (with stat polling the
+    // timeout is simply slept) and append what was added. Returns the
+    // number of bytes read, or the new size after a reload.
+    size_t poll(int timeout_ms = 0) {
+        if (!active) return 0;
+        
+        bool replaced = false;
+#ifdef __linux__
+        if (watch >= 0) {
+            pollfd request{notify_fd, POLLIN, 0};
+            if (::poll(&request, 1, timeout_ms) <= 0) return 0;
+            
+            alignas(inotify_event) char events[4096];
+            ssize_t len;
+            while ((len = ::read(notify_fd, events, sizeof(events))) > 0) {
+                for (char* p = events; p < events + len;) {
+                    auto* event = reinterpret_cast<inotify_event*>(p);
+                    // Watches dropped by an earlier reload still report IN_IGNORED
+                    if (event->wd == watch && (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))) {
+                        replaced = true;
+                    }
+                    // An unlink only shows up as IN_ATTRIB (link count), since
+                    // our open stream keeps the old inode alive
+                    if (event->wd == watch && (event->mask & IN_ATTRIB) && identify(path) != file_id) {
+                        replaced = true;
+                    }
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+            // Keep following the path, not the old inode; while the path is
+            // missing poll() falls back to stat polling until it reappears
+            if (replaced) {
+                ::inotify_rm_watch(notify_fd, watch);
+                watch = -1;
+            }
+            return catch_up(replaced);
+        }
+#endif
+        if (timeout_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        }
+        size_t added = catch_up(replaced);
+#ifdef __linux__
+        if (watch < 0) add_watch();
+#endif
+        return added;
+    }
+};
+
 #endif // GAP_BUFFER_HPP